@@ -50,42 +50,46 @@ dml_micros()
         return((tv.tv_sec*1000000.0)+tv.tv_usec);
 }
 
+// Number of paths generated, priced and summed at once: the two buffers
+// (8 KB) stay in L1 between the passes
+#define TILE 512
+
 // Function to generate Gaussian noise using Box-Muller transform
-void gaussian_box_muller(std::vector<double> &Z) {
+void gaussian_box_muller(double* Z, size_t n) {
     static std::mt19937 generator(std::random_device{}());
     static std::normal_distribution<double> distribution(0.0, 1.0);
-    for( size_t i=0; i < Z.size(); i+=4){
+    size_t i = 0;
+    for( ; i + 4 <= n; i+=4){
 	Z[i] = distribution(generator);
         Z[i+1] = distribution(generator);
 	Z[i+2] = distribution(generator);
 	Z[i+3] = distribution(generator);
     }
+    for( ; i < n; ++i)
+        Z[i] = distribution(generator);
 }
 
 // Function to calculate the Black-Scholes call option price using Monte Carlo method
 double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sigma, double q, ui64 num_simulations) {
-    std::vector<double> Z(num_simulations);
-    std::vector<double> payoffs(num_simulations);
+    // Fixed scratch reused by every call, one per thread: the memory no
+    // longer grows with num_simulations
+    static thread_local double Z[TILE];
+    static thread_local double payoffs[TILE];
 
-    gaussian_box_muller( Z );
     double drift = (r - q - 0.5 * sigma * sigma) * T;
     double diffusion = sigma * sqrt(T);
 
     double sum_payoffs = 0.0;
-    for (ui64 i = 0; i < num_simulations; i+=4) {
-	double ST1 = S0 * exp( drift + diffusion * Z[i]);
-	double ST2 = S0 * exp( drift + diffusion * Z[i+1]);
-	double ST3 = S0 * exp( drift + diffusion * Z[i+2]);
-	double ST4 = S0 * exp( drift + diffusion * Z[i+3]);
-
-	payoffs[i] = std::max( ST1 - K, 0.0);
-       	payoffs[i+1] = std::max( ST2 - K, 0.0); 
-	payoffs[i+2] = std::max( ST3 - K, 0.0); 
-	payoffs[i+3] = std::max( ST4 - K, 0.0); 
-
+    for (ui64 base = 0; base < num_simulations; base += TILE) {
+        ui64 n = std::min((ui64)TILE, num_simulations - base);
+        gaussian_box_muller( Z, n );
+        for (ui64 i = 0; i < n; ++i) {
+            double ST = S0 * exp( drift + diffusion * Z[i]);
+            payoffs[i] = std::max( ST - K, 0.0);
+        }
+        // Reduction of the tile while it is still in L1
+        sum_payoffs += cblas_dasum(n, payoffs, 1);
     }
-
-    sum_payoffs = cblas_dasum(num_simulations, payoffs.data(), 1);
     return exp(-r * T) * (sum_payoffs / num_simulations);
 }
 
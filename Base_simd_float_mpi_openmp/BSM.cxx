@@ -42,6 +42,7 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
 #include <arm_acle.h>
 #include <cblas.h>
 #include <arm_neon.h>
+#include "../Base_simd_mpi_openmp/simd_math.h"
 #define ui64 u_int64_t
 
 #include <sys/time.h>
@@ -61,8 +62,13 @@ float gaussian_box_muller() {
     return distribution(generator);
 }
 
+// Paths summed per lane in float before the partial sums go into the double
+// total: few enough adds that float rounding stays below the MC noise
+#define FLUSH_PATHS 1024
+
 float black_scholes_monte_carlo(ui64 S0, ui64 K, float T, float r, float sigma, float q, ui64 num_simulations) {
-    float sum_payoffs = 0.0f;
+    // Payoffs are computed in float, accumulated in double
+    double sum_payoffs = 0.0;
     // Constants
     float32x4_t S0_vec = vdupq_n_f32(static_cast<float>(S0));
     float32x4_t K_vec = vdupq_n_f32(static_cast<float>(K));
@@ -82,6 +88,7 @@ float black_scholes_monte_carlo(ui64 S0, ui64 K, float T, float r, float sigma,
     );
     float32x4_t sub_diffusion = vmulq_f32(sigma_vec, vdupq_n_f32(sqrtf(T)));
     float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t sum_vec = zero;
 
     for (ui64 i = 0; i < num_simulations; i += 4) {
         // Generate random numbers (4 per iteration)
@@ -89,16 +96,20 @@ float black_scholes_monte_carlo(ui64 S0, ui64 K, float T, float r, float sigma,
         // Stock price at maturity
         float32x4_t diffusion = vmulq_f32(sub_diffusion, Z);
         float32x4_t exponent = vaddq_f32(drift, diffusion);
-        float32x4_t ST = vmulq_f32(S0_vec,
-            float32x4_t{expf(vgetq_lane_f32(exponent, 0)), expf(vgetq_lane_f32(exponent, 1)),
-                        expf(vgetq_lane_f32(exponent, 2)), expf(vgetq_lane_f32(exponent, 3))});
+        float32x4_t ST = vmulq_f32(S0_vec, simd_math::exp_f32x4(exponent));
         // Payoff calculation
         float32x4_t payoff = vmaxq_f32(vsubq_f32(ST, K_vec), zero);
         // Sum up payoffs
-        sum_payoffs += vgetq_lane_f32(payoff, 0) + vgetq_lane_f32(payoff, 1)
-                     + vgetq_lane_f32(payoff, 2) + vgetq_lane_f32(payoff, 3);
+        sum_vec = vaddq_f32(sum_vec, payoff);
+        if ((i + 4) % FLUSH_PATHS == 0) {
+            sum_payoffs += (double)vgetq_lane_f32(sum_vec, 0) + (double)vgetq_lane_f32(sum_vec, 1)
+                         + (double)vgetq_lane_f32(sum_vec, 2) + (double)vgetq_lane_f32(sum_vec, 3);
+            sum_vec = zero;
+        }
     }
-    return expf(-r * T) * (sum_payoffs / num_simulations);
+    sum_payoffs += (double)vgetq_lane_f32(sum_vec, 0) + (double)vgetq_lane_f32(sum_vec, 1)
+                 + (double)vgetq_lane_f32(sum_vec, 2) + (double)vgetq_lane_f32(sum_vec, 3);
+    return (float)(exp(-(double)r * T) * (sum_payoffs / num_simulations));
 }
 
 #include <cmath> // Pour std::erf et std::sqrt
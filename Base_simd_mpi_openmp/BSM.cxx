@@ -36,14 +36,38 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
 #include <limits>
 #include <algorithm>
 #include <iomanip>   // For setting precision
+#include <string>
 #include <mpi.h>
 #include <omp.h>
 
+#if defined(__ARM_NEON)
 #include <arm_acle.h>
-#include <cblas.h>
 #include <arm_neon.h>
+#endif
+#include <cblas.h>
 #define ui64 u_int64_t
 
+#include "rng.h"
+#include "simd_math.h"
+#include "gaussian.h"
+#include "bench.h"
+#include "pricing.h"
+#include "scratch.h"
+#include "reduce.h"
+#include "closed_form.h"
+#include "estimator.h"
+#include "tune.h"
+#include "adaptive.h"
+#include "mlmc.h"
+#include "book.h"
+#include "portfolio.h"
+
+// Default number of draws generated, priced and reduced at once (--tile),
+// small enough to stay in L1
+#define GAUSS_BLOCK 512
+// Paths per run of an autotuner calibration (--autotune)
+#define TUNE_PATHS (1 << 17)
+
 #include <sys/time.h>
 double
 dml_micros()
@@ -54,61 +78,1005 @@ dml_micros()
         return((tv.tv_sec*1000000.0)+tv.tv_usec);
 }
 
-// Function to generate Gaussian noise using Box-Muller transform
-double gaussian_box_muller() {
-    static std::mt19937 generator(std::random_device{}());
-    static std::normal_distribution<double> distribution(0.0, 1.0);
-    return distribution(generator);
-}
-
-// Function to calculate the Black-Scholes call option price using Monte Carlo method
-double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sigma, double q, ui64 num_simulations) {
-    double sum_payoffs = 0.0;
-    // Constants
-    float64x2_t S0_vec = vdupq_n_f64(S0);
-    float64x2_t K_vec = vdupq_n_f64(K);
-    float64x2_t r_vec = vdupq_n_f64(r);
-    float64x2_t q_vec = vdupq_n_f64(q);
-    float64x2_t sigma_vec = vdupq_n_f64(sigma);
-    float64x2_t T_vec = vdupq_n_f64(T);
-    float64x2_t half= vdupq_n_f64(0.5);
-    // Not affected by the random number
-    float64x2_t drift = vmulq_f64(
-	    vsubq_f64(
-		    vsubq_f64(r_vec, q_vec),
-		    vmulq_f64( half, vmulq_f64(sigma_vec, sigma_vec))
-		    ),
-	    T_vec
-    );
-    float64x2_t sub_diffusion = vmulq_f64(sigma_vec, vdupq_n_f64(sqrt(T)));
+// Function to calculate the Black-Scholes call option price using Monte Carlo method.
+// Returns the undiscounted sum of the payoffs: each tile is summed on its own
+// in a fixed order and goes into a compensated sum (reduce.h), the caller
+// discounts and divides once for the whole job.
+template <class Gauss>
+CompensatedSum black_scholes_monte_carlo(const PricingPlan& plan, ui64 num_simulations, Gauss& gauss,
+                                         TileScratch& scratch) {
+    CompensatedSum sum_payoffs;
+    double* Z = scratch.z();
+    const ui64 tile = scratch.tile();
+#if defined(__ARM_NEON)
+    // Constants, not affected by the random number
+    float64x2_t S0_vec = vdupq_n_f64(plan.S0);
+    float64x2_t K_vec = vdupq_n_f64(plan.K);
+    float64x2_t drift = vdupq_n_f64(plan.drift);
+    float64x2_t sub_diffusion = vdupq_n_f64(plan.diffusion);
     float64x2_t zero =  vdupq_n_f64(0.0);
-    for (ui64 i = 0; i < num_simulations; i += 2) {
-        // Generate random numbers (2 per iteration)
-        float64x2_t Z = {gaussian_box_muller(), gaussian_box_muller()};
-        // Stock price at maturity
-        float64x2_t diffusion = vmulq_f64(sub_diffusion, Z);
-        float64x2_t exponent = vaddq_f64(drift, diffusion);
-        float64x2_t ST = vmulq_f64(S0_vec,
-		       	float64x2_t{exp(vgetq_lane_f64(exponent, 0)), exp(vgetq_lane_f64(exponent, 1))});
-        // Payoff calculation
-        float64x2_t payoff = vmaxq_f64(vsubq_f64(ST, K_vec), zero);
-        // Sum up payoffs
-        sum_payoffs += vgetq_lane_f64(payoff, 0) + vgetq_lane_f64(payoff, 1);
-    }
-    return exp(-r * T) * (sum_payoffs / num_simulations);
+    float64x2_t sum_vec = zero;
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256d S0_vec = _mm256_set1_pd(plan.S0);
+    __m256d K_vec = _mm256_set1_pd(plan.K);
+    __m256d drift = _mm256_set1_pd(plan.drift);
+    __m256d sub_diffusion = _mm256_set1_pd(plan.diffusion);
+    __m256d zero = _mm256_setzero_pd();
+    __m256d sum_vec = zero;
+#endif
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        // Generate a whole tile of random numbers
+        gauss.fill_gaussians(Z, n);
+        // Keep only the draws finishing in the money, the others pay exactly 0:
+        // branch-free compaction in place, no exp() for them
+        ui64 m = 0;
+        for (ui64 k = 0; k < n; ++k) {
+            Z[m] = Z[k];
+            m += Z[k] > plan.z_star;
+        }
+        ui64 i = 0;
+#if defined(__ARM_NEON)
+        for (; i + 2 <= m; i += 2) {
+            float64x2_t Zv = vld1q_f64(Z + i);
+            // Stock price at maturity
+            float64x2_t exponent = vfmaq_f64(drift, sub_diffusion, Zv);
+            float64x2_t ST = vmulq_f64(S0_vec, simd_math::exp_f64x2(exponent));
+            // Payoff calculation, max() only guards the rounding around z*
+            float64x2_t payoff = vmaxq_f64(vsubq_f64(ST, K_vec), zero);
+            // Sum up payoffs
+            sum_vec = vaddq_f64(sum_vec, payoff);
+        }
+#elif defined(__AVX2__) && defined(__FMA__)
+        for (; i + 4 <= m; i += 4) {
+            __m256d exponent = _mm256_fmadd_pd(sub_diffusion, _mm256_load_pd(Z + i), drift);
+            __m256d ST = _mm256_mul_pd(S0_vec, simd_math::exp_f64x4(exponent));
+            sum_vec = _mm256_add_pd(sum_vec, _mm256_max_pd(_mm256_sub_pd(ST, K_vec), zero));
+        }
+#endif
+        // Remaining paths (all of them without SIMD)
+        double tile_sum = 0.0;
+        for (; i < m; ++i) {
+            double ST = plan.S0 * simd_math::exp(plan.drift + plan.diffusion * Z[i]);
+            tile_sum += std::max(ST - plan.K, 0.0);
+        }
+#if defined(__ARM_NEON)
+        tile_sum += vaddvq_f64(sum_vec);
+        sum_vec = zero;
+#elif defined(__AVX2__) && defined(__FMA__)
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, sum_vec);
+        tile_sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        sum_vec = zero;
+#endif
+        sum_payoffs.add(tile_sum);
+    }
+    return sum_payoffs;
+}
+
+// Same kernel in float32 for Precision::Float and Precision::Mixed: normals,
+// exp and payoff on twice as many lanes. The payoffs are summed per lane in
+// float; in Mixed mode these partial sums go into the compensated sum after
+// every tile (at most tile/lanes adds in float), in Float mode they keep
+// growing until the end of the run.
+template <class Gauss>
+CompensatedSum black_scholes_monte_carlo_f32(const PricingPlan& plan, ui64 num_simulations, Gauss& gauss,
+                                             TileScratch& scratch, Precision precision) {
+    CompensatedSum sum_payoffs;
+    float* Z = scratch.z_float();
+    const ui64 tile = scratch.tile();
+    const float S0 = (float)plan.S0, K = (float)plan.K;
+    const float drift_s = (float)plan.drift, diffusion_s = (float)plan.diffusion;
+    const float z_star = (float)plan.z_star;
+    float sum_tail = 0.0f;
+#if defined(__ARM_NEON)
+    float32x4_t S0_vec = vdupq_n_f32(S0);
+    float32x4_t K_vec = vdupq_n_f32(K);
+    float32x4_t drift = vdupq_n_f32(drift_s);
+    float32x4_t sub_diffusion = vdupq_n_f32(diffusion_s);
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t sum_vec = zero;
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256 S0_vec = _mm256_set1_ps(S0);
+    __m256 K_vec = _mm256_set1_ps(K);
+    __m256 drift = _mm256_set1_ps(drift_s);
+    __m256 sub_diffusion = _mm256_set1_ps(diffusion_s);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 sum_vec = zero;
+#endif
+    // Partial sums of the lanes, in double (Mixed) or in float (Float)
+    auto lanes_sum = [&](bool in_double) {
+        double total;
+#if defined(__ARM_NEON)
+        if (in_double)
+            total = ((double)vgetq_lane_f32(sum_vec, 0) + (double)vgetq_lane_f32(sum_vec, 1))
+                  + ((double)vgetq_lane_f32(sum_vec, 2) + (double)vgetq_lane_f32(sum_vec, 3)) + (double)sum_tail;
+        else
+            total = vaddvq_f32(sum_vec) + sum_tail;
+        sum_vec = zero;
+#elif defined(__AVX2__) && defined(__FMA__)
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, sum_vec);
+        if (in_double) {
+            total = sum_tail;
+            for (int l = 0; l < 8; ++l) total += lanes[l];
+        } else {
+            float t = sum_tail;
+            for (int l = 0; l < 8; ++l) t += lanes[l];
+            total = t;
+        }
+        sum_vec = zero;
+#else
+        // A single float accumulator, already the float sum: nothing to
+        // combine in either precision
+        (void)in_double;
+        total = sum_tail;
+#endif
+        sum_tail = 0.0f;
+        return total;
+    };
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        gauss.fill_gaussians(Z, n);
+        // In the money draws only, as in the double kernel
+        ui64 m = 0;
+        for (ui64 k = 0; k < n; ++k) {
+            Z[m] = Z[k];
+            m += Z[k] > z_star;
+        }
+        ui64 i = 0;
+#if defined(__ARM_NEON)
+        for (; i + 4 <= m; i += 4) {
+            float32x4_t exponent = vfmaq_f32(drift, sub_diffusion, vld1q_f32(Z + i));
+            float32x4_t ST = vmulq_f32(S0_vec, simd_math::exp_f32x4(exponent));
+            sum_vec = vaddq_f32(sum_vec, vmaxq_f32(vsubq_f32(ST, K_vec), zero));
+        }
+#elif defined(__AVX2__) && defined(__FMA__)
+        for (; i + 8 <= m; i += 8) {
+            __m256 exponent = _mm256_fmadd_ps(sub_diffusion, _mm256_loadu_ps(Z + i), drift);
+            __m256 ST = _mm256_mul_ps(S0_vec, simd_math::exp_f32x8(exponent));
+            sum_vec = _mm256_add_ps(sum_vec, _mm256_max_ps(_mm256_sub_ps(ST, K_vec), zero));
+        }
+#endif
+        for (; i < m; ++i) {
+            float ST = S0 * simd_math::exp(drift_s + diffusion_s * Z[i]);
+            sum_tail += std::max(ST - K, 0.0f);
+        }
+        if (precision == Precision::Mixed)
+            sum_payoffs.add(lanes_sum(true));
+    }
+    if (precision == Precision::Float)
+        sum_payoffs.add((float)lanes_sum(false));
+    return sum_payoffs;
+}
+
+// Control variate kernel (estimator.h), any precision: every draw is priced,
+// the out of the money ones included since S_T is needed for all of them.
+// The five moments are summed over a tile in Real by an omp simd reduction
+// (fixed lane order), then go into the compensated sums in double.
+template <typename Real, class Gauss>
+Moments black_scholes_monte_carlo_cv(const PricingPlan& plan, ui64 num_simulations, Gauss& gauss, Real* Z,
+                                     ui64 tile) {
+    Moments moments;
+    const Real S0 = (Real)plan.S0, K = (Real)plan.K, F = (Real)plan.forward;
+    const Real drift = (Real)plan.drift, diffusion = (Real)plan.diffusion;
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        gauss.fill_gaussians(Z, n);
+        Real y = 0, yy = 0, x = 0, xx = 0, xy = 0;
+        #pragma omp simd reduction(+:y, yy, x, xx, xy)
+        for (ui64 i = 0; i < n; ++i) {
+            Real ST = S0 * simd_math::exp(drift + diffusion * Z[i]);
+            Real payoff = std::max(ST - K, Real(0));
+            // Centred control, E[S_T - F] = 0
+            Real d = ST - F;
+            y += payoff;
+            yy += payoff * payoff;
+            x += d;
+            xx += d * d;
+            xy += d * payoff;
+        }
+        moments.y.add(y);
+        moments.yy.add(yy);
+        moments.x.add(x);
+        moments.xx.add(xx);
+        moments.xy.add(xy);
+    }
+    return moments;
+}
+
+// Antithetic kernel (estimator.h), any precision: each normal Z gives the
+// paths Z and -Z. S_T(-Z) = S0^2 e^(2 drift) / S_T(Z), so a pair costs one
+// exp and one division; both paths are in the same iteration and the omp
+// simd loop vectorizes over the pairs. A tile of n paths uses n/2 normals,
+// the moments are those of the pair means.
+template <typename Real, class Gauss>
+Moments black_scholes_monte_carlo_antithetic(const PricingPlan& plan, ui64 num_simulations, Gauss& gauss,
+                                             Real* Z, ui64 tile) {
+    Moments moments;
+    const Real A = (Real)(plan.S0 * std::exp(plan.drift)), K = (Real)plan.K, F = (Real)plan.forward;
+    const Real diffusion = (Real)plan.diffusion;
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 pairs = std::min(tile, num_simulations - base) / 2;
+        gauss.fill_gaussians(Z, pairs);
+        Real y = 0, yy = 0, x = 0, xx = 0, xy = 0, single_yy = 0;
+        #pragma omp simd reduction(+:y, yy, x, xx, xy, single_yy)
+        for (ui64 k = 0; k < pairs; ++k) {
+            Real e = simd_math::exp(diffusion * Z[k]);
+            Real S_up = A * e, S_down = A / e;
+            Real p_up = std::max(S_up - K, Real(0)), p_down = std::max(S_down - K, Real(0));
+            Real h = Real(0.5) * (p_up + p_down);
+            Real d = Real(0.5) * (S_up + S_down) - F;
+            y += h;
+            yy += h * h;
+            x += d;
+            xx += d * d;
+            xy += d * h;
+            single_yy += Real(0.5) * (p_up * p_up + p_down * p_down);
+        }
+        moments.y.add(y);
+        moments.yy.add(yy);
+        moments.x.add(x);
+        moments.xx.add(xx);
+        moments.xy.add(xy);
+        moments.single_yy.add(single_yy);
+    }
+    return moments;
+}
+
+// Importance sampling kernel (estimator.h), any precision: Z + mu instead of
+// Z, payoff weighted by exp(-mu Z - mu^2/2). Only the draws with Z + mu > z*
+// pay, they are compacted first as in the plain kernel and the two exp of
+// the others are skipped.
+template <typename Real, class Gauss>
+Moments black_scholes_monte_carlo_is(const PricingPlan& plan, ui64 num_simulations, Gauss& gauss, Real* Z,
+                                     ui64 tile, double shift) {
+    Moments moments;
+    // S_T = S_mu exp(diffusion Z), weight = w0 exp(-mu Z)
+    const Real S_mu = (Real)(plan.S0 * std::exp(plan.drift + plan.diffusion * shift));
+    const Real w0 = (Real)std::exp(-0.5 * shift * shift);
+    const Real K = (Real)plan.K, diffusion = (Real)plan.diffusion, mu = (Real)shift;
+    const Real z_pay = (Real)(plan.z_star - shift);
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        gauss.fill_gaussians(Z, n);
+        ui64 m = 0;
+        for (ui64 k = 0; k < n; ++k) {
+            Z[m] = Z[k];
+            m += Z[k] > z_pay;
+        }
+        Real y = 0, yy = 0;
+        #pragma omp simd reduction(+:y, yy)
+        for (ui64 i = 0; i < m; ++i) {
+            Real ST = S_mu * simd_math::exp(diffusion * Z[i]);
+            Real payoff = std::max(ST - K, Real(0)) * (w0 * simd_math::exp(-mu * Z[i]));
+            y += payoff;
+            yy += payoff * payoff;
+        }
+        moments.y.add(y);
+        moments.yy.add(yy);
+    }
+    return moments;
+}
+
+// Stratified / Latin hypercube kernel (stratify.h), any precision: one
+// uniform per path, moved into the stratum of its index in the run (first
+// is the index of the first path of this rank), then the inverse CDF.
+// Stratified: Y and Y^2 of stratum j go into stratum_sums[2j], [2j+1];
+// both return the sum of the payoffs of the run.
+template <typename Real, class Gauss>
+CompensatedSum black_scholes_monte_carlo_stratified(const PricingPlan& plan, ui64 first, ui64 num_simulations,
+                                                    Gauss& gauss, Real* U, ui64 tile, IcdfAccuracy accuracy,
+                                                    const Estimator& estimator, CompensatedSum* stratum_sums) {
+    CompensatedSum sum_payoffs;
+    const Strata& strata = estimator.strata;
+    const Real S0 = (Real)plan.S0, K = (Real)plan.K, drift = (Real)plan.drift, diffusion = (Real)plan.diffusion;
+    const Real z_star = (Real)plan.z_star;
+    // u of the last stratum can round to 1 (the inverse CDF would blow up)
+    const Real below_one = std::nextafter(Real(1), Real(0));
+    // Payoffs of the in the money draws of U[0..n), compacted in place
+    auto payoffs = [&](Real* Z, ui64 n, Real& y, Real& yy) {
+        ui64 m = 0;
+        for (ui64 k = 0; k < n; ++k) {
+            Z[m] = Z[k];
+            m += Z[k] > z_star;
+        }
+        y = 0;
+        yy = 0;
+        #pragma omp simd reduction(+:y, yy)
+        for (ui64 i = 0; i < m; ++i) {
+            Real payoff = std::max(S0 * simd_math::exp(drift + diffusion * Z[i]) - K, Real(0));
+            y += payoff;
+            yy += payoff * payoff;
+        }
+    };
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        ui64 k0 = first + base;
+        gauss.uniforms().uniforms(U, n);
+        if (estimator.latin_hypercube) {
+            // One stratum per path, u computed in double: 1/N is below the
+            // float resolution
+            #pragma omp simd
+            for (ui64 i = 0; i < n; ++i)
+                U[i] = std::min((Real)lhs::uniform(k0 + i, estimator.paths_per_run, (double)U[i]), below_one);
+            inverse_normal::transform(U, U, n, accuracy);
+            Real y, yy;
+            payoffs(U, n, y, yy);
+            sum_payoffs.add(y);
+            continue;
+        }
+        // Segments of the tile in one stratum
+        double tile_sum = 0.0;
+        for (ui64 i = 0; i < n;) {
+            int j = strata.of(k0 + i);
+            ui64 end = std::min(n, strata.first[j + 1] - k0);
+            Real* seg = U + i;
+            const double M = strata.count;
+            #pragma omp simd
+            for (ui64 t = 0; t < end - i; ++t)
+                seg[t] = std::min((Real)((j + (double)seg[t]) / M), below_one);
+            inverse_normal::transform(seg, seg, end - i, accuracy);
+            Real y, yy;
+            payoffs(seg, end - i, y, yy);
+            stratum_sums[2 * j].add(y);
+            stratum_sums[2 * j + 1].add(yy);
+            tile_sum += y;
+            i = end;
+        }
+        sum_payoffs.add(tile_sum);
+    }
+    return sum_payoffs;
+}
+
+// MLMC level l (mlmc.h) on n coupled paths: 2^l Milstein steps on the fine
+// path, 2^(l-1) on the coarse one driven by the sums of two consecutive fine
+// increments. The normals of a step are drawn for the whole tile at once,
+// Z[i] and Z[n + i] are the two fine increments of path i.
+template <class Engine>
+void black_scholes_monte_carlo_mlmc(const mlmc::Problem& problem, int level, ui64 n, GaussianStream<Engine>& gauss,
+                                    double* Z, double* fine, double* coarse, mlmc::LevelSums& sums) {
+    const ui64 steps = 1ull << level;
+    const double h = problem.T / steps, sqrt_h = std::sqrt(h);
+    const double mu = problem.rate, sigma = problem.sigma, half_s2 = 0.5 * sigma * sigma;
+    for (ui64 i = 0; i < n; ++i) fine[i] = coarse[i] = problem.S0;
+    if (level == 0) {
+        gauss.fill_gaussians(Z, n);
+        #pragma omp simd
+        for (ui64 i = 0; i < n; ++i) {
+            double dW = sqrt_h * Z[i];
+            fine[i] *= 1.0 + mu * h + sigma * dW + half_s2 * (dW * dW - h);
+        }
+    }
+    for (ui64 step = 0; level > 0 && step < steps / 2; ++step) {
+        gauss.fill_gaussians(Z, 2 * n);
+        #pragma omp simd
+        for (ui64 i = 0; i < n; ++i) {
+            double dW1 = sqrt_h * Z[i], dW2 = sqrt_h * Z[n + i], dW = dW1 + dW2;
+            double S = fine[i];
+            S *= 1.0 + mu * h + sigma * dW1 + half_s2 * (dW1 * dW1 - h);
+            S *= 1.0 + mu * h + sigma * dW2 + half_s2 * (dW2 * dW2 - h);
+            fine[i] = S;
+            coarse[i] *= 1.0 + 2.0 * mu * h + sigma * dW + half_s2 * (dW * dW - 2.0 * h);
+        }
+    }
+    // Tile sums in a fixed order, then into the compensated sums
+    double y = 0.0, yy = 0.0, f = 0.0, ff = 0.0;
+    const double K = problem.K, discount = problem.discount;
+    const bool coupled = level > 0;
+    #pragma omp simd reduction(+:y,yy,f,ff)
+    for (ui64 i = 0; i < n; ++i) {
+        double pf = discount * std::max(fine[i] - K, 0.0);
+        double pc = coupled ? discount * std::max(coarse[i] - K, 0.0) : 0.0;
+        double d = pf - pc;
+        y += d;
+        yy += d * d;
+        f += pf;
+        ff += pf * pf;
+    }
+    sums.y.add(y);
+    sums.yy.add(yy);
+    sums.fine.add(f);
+    sums.fine2.add(ff);
+}
+
+// Option book kernel (book.h): one tile of normals for the whole book, per
+// group the terminal values of the tile (one exp per path), then every
+// path against the strike ladder of the group in an omp simd loop over the
+// contracts. The tile sums of Y and Y^2 of contract j go into sums[2j],
+// sums[2j+1]; ST, acc and acc2 are thread scratch of tile, size and size.
+template <class Engine>
+void black_scholes_monte_carlo_book(const OptionBook& book, ui64 num_simulations, GaussianStream<Engine>& gauss,
+                                    double* Z, ui64 tile, double* ST, double* acc, double* acc2,
+                                    CompensatedSum* sums) {
+    const double* K = book.K.data();
+    const double* sign = book.sign.data();
+    for (ui64 base = 0; base < num_simulations; base += tile) {
+        ui64 n = std::min(tile, num_simulations - base);
+        gauss.fill_gaussians(Z, n);
+        for (size_t g = 0; g < book.groups(); ++g) {
+            const PricingPlan& plan = book.plan[g];
+            const size_t begin = book.first[g], end = book.first[g + 1];
+            #pragma omp simd
+            for (ui64 i = 0; i < n; ++i)
+                ST[i] = plan.S0 * simd_math::exp(plan.drift + plan.diffusion * Z[i]);
+            for (size_t j = begin; j < end; ++j) acc[j] = acc2[j] = 0.0;
+            for (ui64 i = 0; i < n; ++i) {
+                const double S = ST[i];
+                #pragma omp simd
+                for (size_t j = begin; j < end; ++j) {
+                    double payoff = std::max(sign[j] * (S - K[j]), 0.0);
+                    acc[j] += payoff;
+                    acc2[j] += payoff * payoff;
+                }
+            }
+            for (size_t j = begin; j < end; ++j) {
+                sums[2 * j].add(acc[j]);
+                sums[2 * j + 1].add(acc2[j]);
+            }
+        }
+    }
+}
+
+// All the runs of this rank with one uniform engine per thread. The static
+// schedule gives each thread the same runs from one execution to the next,
+// which the state based engines need to be reproducible.
+template <class Engine>
+void price_runs(uint64_t global_seed, int rank, const GaussConfig& gauss_config, ui64 first_run, ui64 num_runs,
+                ui64 first_point, ui64 group_simulations, ui64 simulations_per_process,
+                const PricingPlan& plan, Precision precision, ui64 tile, const Estimator& estimator,
+                std::vector<Moments>& run_sums, std::vector<CompensatedSum>& stratum_sums) {
+    // Per stratum sums of every thread, merged in thread order at the end
+    std::vector<std::vector<CompensatedSum>> thread_sums(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        GaussianStream<Engine> gauss(global_seed, rank, omp_get_thread_num(), gauss_config);
+        TileScratch scratch(tile);
+        std::vector<CompensatedSum>& strata_sums = thread_sums[omp_get_thread_num()];
+        strata_sums.assign(2 * estimator.strata.count, CompensatedSum());
+        #pragma omp for schedule(static)
+        for (ui64 i = 0; i < num_runs; ++i) {
+            const ui64 run = first_run + i;
+            // Philox: stream of the run, this rank reads its own slice of it
+            // (antithetic: one normal per pair of paths)
+            ui64 per_path = estimator.antithetic ? 2 : 1;
+            gauss.start_run(run);
+            gauss.seek_draw(first_point / per_path);
+            // QMC: every (run, rank) takes its own contiguous block of the sequence
+            gauss.seek_point((run * group_simulations + first_point) / per_path);
+            if (estimator.strata.count > 0 || estimator.latin_hypercube)
+                run_sums[i].y = precision == Precision::Double
+                                ? black_scholes_monte_carlo_stratified(plan, first_point, simulations_per_process, gauss,
+                                                                       scratch.z(), tile, gauss_config.accuracy,
+                                                                       estimator, strata_sums.data())
+                                : black_scholes_monte_carlo_stratified(plan, first_point, simulations_per_process, gauss,
+                                                                       scratch.z_float(), tile, gauss_config.accuracy,
+                                                                       estimator, strata_sums.data());
+            else if (estimator.importance)
+                run_sums[i] = precision == Precision::Double
+                              ? black_scholes_monte_carlo_is(plan, simulations_per_process, gauss, scratch.z(), tile,
+                                                             estimator.shift)
+                              : black_scholes_monte_carlo_is(plan, simulations_per_process, gauss, scratch.z_float(),
+                                                             tile, estimator.shift);
+            else if (estimator.antithetic)
+                run_sums[i] = precision == Precision::Double
+                              ? black_scholes_monte_carlo_antithetic(plan, simulations_per_process, gauss, scratch.z(), tile)
+                              : black_scholes_monte_carlo_antithetic(plan, simulations_per_process, gauss, scratch.z_float(), tile);
+            else if (estimator.control_variate)
+                run_sums[i] = precision == Precision::Double
+                              ? black_scholes_monte_carlo_cv(plan, simulations_per_process, gauss, scratch.z(), tile)
+                              : black_scholes_monte_carlo_cv(plan, simulations_per_process, gauss, scratch.z_float(), tile);
+            else
+                run_sums[i].y = precision == Precision::Double
+                                ? black_scholes_monte_carlo(plan, simulations_per_process, gauss, scratch)
+                                : black_scholes_monte_carlo_f32(plan, simulations_per_process, gauss, scratch, precision);
+        }
+    }
+    stratum_sums.assign(2 * estimator.strata.count, CompensatedSum());
+    for (const std::vector<CompensatedSum>& sums : thread_sums)
+        for (size_t i = 0; i < sums.size(); ++i)
+            stratum_sums[i].merge(sums[i]);
+}
+
+// Runtime choice of the uniform engine (--rng); prices the runs
+// [first_run, first_run + num_runs) into run_sums[0, num_runs)
+void dispatch_runs(const std::string& engine, uint64_t global_seed, int rank, const GaussConfig& gauss_config,
+                   ui64 first_run, ui64 num_runs, ui64 first_point, ui64 group_simulations,
+                   ui64 simulations_per_process, const PricingPlan& plan, Precision precision, ui64 tile,
+                   const Estimator& estimator, std::vector<Moments>& run_sums,
+                   std::vector<CompensatedSum>& stratum_sums) {
+    if (engine == "xoshiro")
+        price_runs<Xoshiro256pp>(global_seed, rank, gauss_config, first_run, num_runs, first_point,
+                                 group_simulations, simulations_per_process, plan, precision, tile, estimator,
+                                 run_sums, stratum_sums);
+    else if (engine == "mt19937")
+        price_runs<Mt19937Engine>(global_seed, rank, gauss_config, first_run, num_runs, first_point,
+                                  group_simulations, simulations_per_process, plan, precision, tile, estimator,
+                                  run_sums, stratum_sums);
+    else if (engine == "sfmt")
+        price_runs<SfmtEngine>(global_seed, rank, gauss_config, first_run, num_runs, first_point,
+                               group_simulations, simulations_per_process, plan, precision, tile, estimator,
+                               run_sums, stratum_sums);
+    else
+        price_runs<PhiloxEngine>(global_seed, rank, gauss_config, first_run, num_runs, first_point,
+                                 group_simulations, simulations_per_process, plan, precision, tile, estimator,
+                                 run_sums, stratum_sums);
+}
+
+// Autotuner calibration of one configuration: the same total work for every
+// candidate (2 runs of TUNE_PATHS per hardware thread of the rank), best of
+// 2 timings of the slowest rank
+double calibration_seconds(const TuneConfig& config, int rank, int max_threads, GaussConfig gauss_config,
+                           const PricingPlan& plan, const Estimator& estimator) {
+    gauss_config.method = config.method;
+    gauss_config.single = config.precision != Precision::Double;
+    if (config.method == GaussMethod::Ziggurat) ziggurat::tables();
+    omp_set_num_threads(config.threads);
+    ui64 runs = 2 * max_threads;
+    ui64 sims = TUNE_PATHS / config.tile * config.tile;
+    std::vector<Moments> run_sums(runs);
+    std::vector<CompensatedSum> stratum_sums;
+    double best = std::numeric_limits<double>::infinity();
+    for (int rep = 0; rep < 2; ++rep) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double t1 = dml_micros();
+        dispatch_runs(config.engine, 0, rank, gauss_config, 0, runs, 0, sims, sims, plan, config.precision,
+                      config.tile, estimator, run_sums, stratum_sums);
+        double seconds = (dml_micros() - t1) / 1000000.0, slowest;
+        MPI_Allreduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        best = std::min(best, slowest);
+    }
+    return best;
+}
+
+// All the runs of the option book on this rank, split like price_runs; the
+// per contract sums of every thread are merged in thread order into sums
+template <class Engine>
+void price_book_runs(uint64_t global_seed, int rank, const GaussConfig& gauss_config, ui64 num_runs,
+                     ui64 first_point, ui64 group_simulations, ui64 simulations_per_process, const OptionBook& book,
+                     ui64 tile, std::vector<CompensatedSum>& sums) {
+    std::vector<std::vector<CompensatedSum>> thread_sums(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        GaussianStream<Engine> gauss(global_seed, rank, omp_get_thread_num(), gauss_config);
+        TileScratch scratch(tile);
+        std::vector<double> ST(tile), acc(book.size()), acc2(book.size());
+        std::vector<CompensatedSum>& mine = thread_sums[omp_get_thread_num()];
+        mine.assign(2 * book.size(), CompensatedSum());
+        #pragma omp for schedule(static)
+        for (ui64 run = 0; run < num_runs; ++run) {
+            gauss.start_run(run);
+            gauss.seek_draw(first_point);
+            gauss.seek_point(run * group_simulations + first_point);
+            black_scholes_monte_carlo_book(book, simulations_per_process, gauss, scratch.z(), tile, ST.data(),
+                                           acc.data(), acc2.data(), mine.data());
+        }
+    }
+    sums.assign(2 * book.size(), CompensatedSum());
+    for (const std::vector<CompensatedSum>& mine : thread_sums)
+        for (size_t i = 0; i < mine.size(); ++i)
+            sums[i].merge(mine[i]);
+}
+
+void dispatch_book(const std::string& engine, uint64_t global_seed, int rank, const GaussConfig& gauss_config,
+                   ui64 num_runs, ui64 first_point, ui64 group_simulations, ui64 simulations_per_process,
+                   const OptionBook& book, ui64 tile, std::vector<CompensatedSum>& sums) {
+    if (engine == "xoshiro")
+        price_book_runs<Xoshiro256pp>(global_seed, rank, gauss_config, num_runs, first_point, group_simulations,
+                                      simulations_per_process, book, tile, sums);
+    else if (engine == "mt19937")
+        price_book_runs<Mt19937Engine>(global_seed, rank, gauss_config, num_runs, first_point, group_simulations,
+                                       simulations_per_process, book, tile, sums);
+    else if (engine == "sfmt")
+        price_book_runs<SfmtEngine>(global_seed, rank, gauss_config, num_runs, first_point, group_simulations,
+                                    simulations_per_process, book, tile, sums);
+    else
+        price_book_runs<PhiloxEngine>(global_seed, rank, gauss_config, num_runs, first_point, group_simulations,
+                                      simulations_per_process, book, tile, sums);
+}
+
+// Portfolio (portfolio.h): chunk c of the file goes to rank c % size, the
+// threads of the rank split it into slices priced as option books on the
+// draws every contract uses (the Philox stream of each run, from its start).
+// A contract's price depends on its own parameters only, not on the chunk,
+// the slice nor the rank. Every round of one chunk per rank is appended to
+// the output in chunk order by MPI_File_write_ordered. Returns the seconds.
+double price_portfolio(const MappedPortfolio& file, MPI_File out, uint64_t global_seed, int rank, int size,
+                       const GaussConfig& gauss_config, ui64 num_runs, ui64 num_simulations, ui64 tile, ui64 chunk,
+                       bool closed) {
+    double t1 = dml_micros();
+    const ui64 chunks = (file.size() + chunk - 1) / chunk;
+    std::string header = closed ? "index,value\n" : "index,value,stderr\n";
+    MPI_File_write_ordered(out, header.data(), rank == 0 ? (int)header.size() : 0, MPI_CHAR, MPI_STATUS_IGNORE);
+    for (ui64 round = 0; round * size < chunks; ++round) {
+        const ui64 c = round * size + rank;
+        std::string text;
+        if (c < chunks) {
+            const ui64 first = c * chunk, count = std::min(chunk, file.size() - first);
+            const PortfolioRecord* records = file.records() + first;
+            std::vector<double> value(count), error(count);
+            #pragma omp parallel
+            {
+                const int threads = omp_get_num_threads(), thread = omp_get_thread_num();
+                const ui64 begin = count * thread / threads, end = count * (thread + 1) / threads;
+                OptionBook book;
+                for (ui64 i = begin; i < end; ++i) {
+                    const PortfolioRecord& contract = records[i];
+                    book.add(contract.S0, contract.K, contract.T, contract.r, contract.sigma, contract.q,
+                             contract.type == 0);
+                }
+                book.group();
+                std::vector<CompensatedSum> sums(2 * book.size());
+                if (!closed && book.size() > 0) {
+                    GaussianStream<PhiloxEngine> gauss(global_seed, rank, thread, gauss_config);
+                    TileScratch scratch(tile);
+                    std::vector<double> ST(tile), acc(book.size()), acc2(book.size());
+                    for (ui64 run = 0; run < num_runs; ++run) {
+                        gauss.start_run(run);
+                        gauss.seek_draw(0);
+                        gauss.seek_point(run * num_simulations);
+                        black_scholes_monte_carlo_book(book, num_simulations, gauss, scratch.z(), tile, ST.data(),
+                                                       acc.data(), acc2.data(), sums.data());
+                    }
+                }
+                const double n = (double)num_runs * num_simulations;
+                for (size_t g = 0; g < book.groups(); ++g) {
+                    const PricingPlan& plan = book.plan[g];
+                    for (size_t j = book.first[g]; j < book.first[g + 1]; ++j) {
+                        const ui64 i = begin + book.id[j];
+                        if (closed) {
+                            value[i] = closed_form::price(plan.forward, book.K[j], plan.diffusion, plan.discount,
+                                                          book.sign[j] > 0.0);
+                            continue;
+                        }
+                        double mean = sums[2 * j].value() / n;
+                        double var = n > 1.0 ? std::max(sums[2 * j + 1].value() / n - mean * mean, 0.0) * n
+                                                   / (n - 1) : 0.0;
+                        value[i] = plan.discount * mean;
+                        error[i] = plan.discount * std::sqrt(var / n);
+                    }
+                }
+            }
+            // The pages of this chunk are not needed again
+            file.release(first, count);
+            char line[96];
+            for (ui64 i = 0; i < count; ++i) {
+                int length = closed ? std::snprintf(line, sizeof(line), "%llu,%.10f\n",
+                                                    (unsigned long long)(first + i), value[i])
+                                    : std::snprintf(line, sizeof(line), "%llu,%.10f,%.10f\n",
+                                                    (unsigned long long)(first + i), value[i], error[i]);
+                text.append(line, length);
+            }
+        }
+        MPI_File_write_ordered(out, text.data(), (int)text.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    return (dml_micros() - t1) / 1000000.0;
+}
+
+// Adaptive stopping (adaptive.h): rounds of runs until the rule is met or
+// max_runs. The reduction of round k runs while round k+1 is priced; run_sums
+// gets the local sums of every run priced, as the fixed size path would.
+adaptive::Stop adaptive_runs(const std::string& engine, uint64_t global_seed, int rank, const GaussConfig& gauss_config,
+                             ui64 max_runs, ui64 first_point, ui64 group_simulations, ui64 simulations_per_process,
+                             const PricingPlan& plan, Precision precision, ui64 tile, const Estimator& estimator,
+                             const adaptive::Rule& rule, double t_start, MPI_Comm comm, std::vector<Moments>& run_sums,
+                             Welford& runs) {
+    // Same round on every rank whatever its threads, or the collectives would not match
+    int threads = omp_get_max_threads(), max_threads;
+    MPI_Allreduce(&threads, &max_threads, 1, MPI_INT, MPI_MAX, comm);
+    const ui64 round = adaptive::round_runs(group_simulations, max_threads);
+    // Samples of a run: paths, or pairs of paths when antithetic
+    const double samples = (double)group_simulations / (estimator.antithetic ? 2 : 1);
+    std::vector<Moments> sums;
+    std::vector<CompensatedSum> stratum_sums, send(round), received(round);
+    // Times are those of the slowest rank, the same everywhere
+    double elapsed = (dml_micros() - t_start) / 1000000.0, loop_start, slowest = 0.0, reduced_elapsed = 0.0;
+    MPI_Allreduce(&elapsed, &loop_start, 1, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Request requests[2];
+    bool in_flight = false;
+    ui64 done = 0, in_flight_runs = 0, reduced_rounds = 0;
+    adaptive::Stop stop = adaptive::Stop::Running;
+    for (;;) {
+        ui64 count = stop == adaptive::Stop::Running ? std::min(round, max_runs - done) : 0;
+        if (count > 0) {
+            sums.assign(count, Moments());
+            dispatch_runs(engine, global_seed, rank, gauss_config, done, count, first_point, group_simulations,
+                          simulations_per_process, plan, precision, tile, estimator, sums, stratum_sums);
+            run_sums.insert(run_sums.end(), sums.begin(), sums.end());
+        }
+        // Previous round: its run prices in run order, the same on every rank
+        if (in_flight) {
+            MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+            for (ui64 i = 0; i < in_flight_runs; ++i)
+                runs.add(plan.discount * received[i].value() / samples);
+            reduced_elapsed = slowest;
+            ++reduced_rounds;
+            in_flight = false;
+        }
+        if (count > 0) {
+            for (ui64 i = 0; i < count; ++i)
+                send[i] = sums[i].y;
+            elapsed = (dml_micros() - t_start) / 1000000.0;
+            MPI_Iallreduce(send.data(), received.data(), (int)count, reduce::mpi_type(), reduce::mpi_sum(), comm,
+                           &requests[0]);
+            MPI_Iallreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, comm, &requests[1]);
+            in_flight = true;
+            in_flight_runs = count;
+            done += count;
+        }
+        else if (!in_flight) break;
+        if (stop == adaptive::Stop::Running && reduced_rounds > 0)
+            stop = adaptive::check(rule, runs, reduced_elapsed, (reduced_elapsed - loop_start) / reduced_rounds,
+                                   done, max_runs);
+    }
+    return stop == adaptive::Stop::Running ? adaptive::Stop::MaxRuns : stop;
+}
+
+// One MLMC pass: count[l] more paths of every level l from path first[l]
+// on, by tiles. The tiles of all the levels are dealt round robin to the
+// ranks (the levels are interleaved, every rank gets its share of the deep,
+// expensive ones) and dynamically to the threads; each tile reads its own
+// slice of the Philox stream of its level, so sums gets the same totals on
+// every rank whatever the layout.
+void mlmc_sample(uint64_t global_seed, int rank, int size, const GaussConfig& gauss_config,
+                 const mlmc::Problem& problem, ui64 tile, const std::vector<ui64>& first,
+                 const std::vector<ui64>& count, std::vector<mlmc::LevelSums>& sums) {
+    const int levels = (int)count.size();
+    std::vector<std::pair<int, ui64>> tiles;    // (level, tile index in the level)
+    for (int l = 0; l < levels; ++l)
+        for (ui64 t = first[l] / tile; t < (first[l] + count[l]) / tile; ++t)
+            tiles.push_back({l, t});
+    std::vector<std::vector<mlmc::LevelSums>> thread_sums(omp_get_max_threads(),
+                                                          std::vector<mlmc::LevelSums>(levels));
+    #pragma omp parallel
+    {
+        GaussianStream<PhiloxEngine> gauss(global_seed, rank, omp_get_thread_num(), gauss_config);
+        // Two tiles of normals, the fine and the coarse paths
+        TileScratch scratch(4 * tile);
+        double* Z = scratch.z();
+        std::vector<mlmc::LevelSums>& mine = thread_sums[omp_get_thread_num()];
+        #pragma omp for schedule(dynamic)
+        for (size_t i = rank; i < tiles.size(); i += size) {
+            int level = tiles[i].first;
+            gauss.start_run(level);
+            gauss.seek_draw((tiles[i].second * tile) << level);
+            black_scholes_monte_carlo_mlmc(problem, level, tile, gauss, Z, Z + 2 * tile, Z + 3 * tile, mine[level]);
+        }
+    }
+    std::vector<mlmc::LevelSums> local(levels);
+    for (const std::vector<mlmc::LevelSums>& mine : thread_sums)
+        for (int l = 0; l < levels; ++l)
+            local[l].merge(mine[l]);
+    MPI_Allreduce(local.data(), sums.data(), levels * mlmc::LevelSums::PAIRS, reduce::mpi_type(), reduce::mpi_sum(),
+                  MPI_COMM_WORLD);
 }
 
 #include <cmath> // Pour std::erf et std::sqrt
 int main(int argc, char* argv[]) {
     MPI_Init(&argc, &argv);
+    // Origin of --deadline
+    const double t_start = dml_micros();
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
-    if (argc != 3) {
-	if(rank == 0)std::cerr << "Usage: " << argv[0] << " <num_simulations> <num_runs>" << std::endl;
+    if (argc < 3) {
+	if(rank == 0)std::cerr << "Usage: " << argv[0] << " <num_simulations> <num_runs> [--gauss boxmuller|ziggurat|icdf] [--icdf fast|refined]"
+                             << " [--qmc sobol] [--scramble owen|shift|none] [--rqmc <replicates>] [--seed <n>]"
+                             << " [--rng philox|xoshiro|mt19937|sfmt] [--bench rng|math|closed] [--tile <draws>]"
+                             << " [--precision double|float|mixed] [--autotune auto|sweep|off]"
+                             << " [--autotune-scope layout|all] [--autotune-cache <file>] [--pricer mc|auto]"
+                             << " [--cv on|off] [--antithetic on|off]"
+                             << " [--importance auto|off] [--stratify <strata>] [--allocation proportional|neyman]"
+                             << " [--lhs on|off] [--moment-match on|off] [--target-stderr <price>]"
+                             << " [--deadline <seconds>] [--mlmc <epsilon>] [--book <strikes>x<maturities>]"
+                             << " [--portfolio <file.bin|file.csv>] [--output <file>] [--chunk <contracts>]"
+                             << " [--overwrite on|off]"
+                             << std::endl;
 	MPI_Finalize();
         return 1;
     }
+    // Optional arguments
+    GaussConfig gauss_config;
+    int replicates = 1;
+    std::string engine = "philox";
+    std::string bench_mode;
+    ui64 tile = GAUSS_BLOCK;
+    Precision precision = Precision::Double;
+    bool fixed_seed = false;
+    unsigned long long global_seed = 0;
+    std::string pricer = "mc";
+    Estimator estimator;
+    int strata_count = 0;
+    Allocation allocation = Allocation::Proportional;
+    std::string tune_mode = "off";
+    std::string tune_cache = tune::default_path();
+    bool tune_all = false;
+    adaptive::Rule stop_rule;
+    double mlmc_epsilon = 0.0;
+    int book_strikes = 0, book_maturities = 0;
+    std::string portfolio_path, output_path = "prices.csv";
+    ui64 chunk = 16384;
+    bool overwrite = false;
+    for (int a = 3; a + 1 < argc; a += 2) {
+        std::string opt = argv[a], val = argv[a + 1];
+        if (opt == "--gauss" && val == "ziggurat") gauss_config.method = GaussMethod::Ziggurat;
+        else if (opt == "--gauss" && val == "boxmuller") gauss_config.method = GaussMethod::BoxMuller;
+        else if (opt == "--gauss" && val == "icdf") gauss_config.method = GaussMethod::InverseCDF;
+        else if (opt == "--icdf" && val == "fast") gauss_config.accuracy = IcdfAccuracy::Fast;
+        else if (opt == "--icdf" && val == "refined") gauss_config.accuracy = IcdfAccuracy::Refined;
+        else if (opt == "--qmc" && val == "sobol") gauss_config.qmc = true;
+        else if (opt == "--scramble" && val == "owen") gauss_config.scramble = Scramble::Owen;
+        else if (opt == "--scramble" && val == "shift") gauss_config.scramble = Scramble::DigitalShift;
+        else if (opt == "--scramble" && val == "none") gauss_config.scramble = Scramble::None;
+        else if (opt == "--rqmc" && std::stoi(val) >= 1 && std::stoi(val) <= size) {
+            gauss_config.qmc = true;
+            replicates = std::stoi(val);
+        }
+        else if (opt == "--rng" && (val == "philox" || val == "xoshiro" || val == "mt19937" || val == "sfmt"))
+            engine = val;
+        else if (opt == "--bench" && (val == "rng" || val == "math" || val == "closed")) bench_mode = val;
+        else if (opt == "--tile" && std::stoull(val) >= 8 && std::stoull(val) % 8 == 0) tile = std::stoull(val);
+        else if (opt == "--precision" && val == "double") precision = Precision::Double;
+        else if (opt == "--precision" && val == "float") precision = Precision::Float;
+        else if (opt == "--precision" && val == "mixed") precision = Precision::Mixed;
+        else if (opt == "--stratify" && std::stoi(val) >= 1) strata_count = std::stoi(val);
+        else if (opt == "--allocation" && val == "proportional") allocation = Allocation::Proportional;
+        else if (opt == "--allocation" && val == "neyman") allocation = Allocation::Neyman;
+        else if (opt == "--moment-match" && (val == "on" || val == "off")) gauss_config.moment_match = val == "on";
+        else if (opt == "--lhs" && (val == "on" || val == "off")) estimator.latin_hypercube = val == "on";
+        else if (opt == "--importance" && (val == "auto" || val == "off")) estimator.importance = val == "auto";
+        else if (opt == "--antithetic" && (val == "on" || val == "off")) estimator.antithetic = val == "on";
+        else if (opt == "--cv" && (val == "on" || val == "off")) estimator.control_variate = val == "on";
+        else if (opt == "--pricer" && (val == "mc" || val == "auto")) pricer = val;
+        else if (opt == "--autotune" && (val == "auto" || val == "sweep" || val == "off")) tune_mode = val;
+        else if (opt == "--autotune-scope" && (val == "layout" || val == "all")) tune_all = val == "all";
+        else if (opt == "--autotune-cache") tune_cache = val;
+        else if (opt == "--target-stderr" && std::stod(val) > 0.0) stop_rule.target_stderr = std::stod(val);
+        else if (opt == "--deadline" && std::stod(val) > 0.0) stop_rule.deadline = std::stod(val);
+        else if (opt == "--mlmc" && std::stod(val) > 0.0) mlmc_epsilon = std::stod(val);
+        else if (opt == "--book" && std::sscanf(val.c_str(), "%dx%d", &book_strikes, &book_maturities) == 2
+                 && book_strikes >= 1 && book_maturities >= 1) {}
+        else if (opt == "--portfolio") portfolio_path = val;
+        else if (opt == "--output") output_path = val;
+        else if (opt == "--chunk" && std::stoull(val) >= 1) chunk = std::stoull(val);
+        else if (opt == "--overwrite" && (val == "on" || val == "off")) overwrite = val == "on";
+        else if (opt == "--seed") {
+            fixed_seed = true;
+            global_seed = std::stoull(val);
+        }
+        else {
+            if(rank == 0) std::cerr << "Unknown option: " << opt << " " << val << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    // Input parameters
+    ui64 S0      = 100;                   // Initial stock price
+    ui64 K       = 110;                   // Strike price
+    double T     = 1.0;                   // Time to maturity (1 year)
+    double r     = 0.06;                  // Risk-free interest rate
+    double sigma = 0.2;                   // Volatility
+    double q     = 0.03;                  // Dividend yield
+    // Everything that does not depend on the draws, computed once
+    const PricingPlan plan = make_pricing_plan(S0, K, T, r, sigma, q);
+    // Importance sampling shift, from the log-strike threshold of the plan
+    if (estimator.importance) {
+        if (estimator.control_variate || estimator.antithetic) {
+            if(rank == 0) std::cerr << "Error: --importance does not combine with --cv or --antithetic." << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+        estimator.shift = importance_shift(plan);
+    }
+    // Stratified and Latin hypercube sampling move the uniform of each path,
+    // they replace the other variance reductions and QMC
+    bool sampled = strata_count > 0 || estimator.latin_hypercube;
+    if (sampled && (gauss_config.qmc || estimator.control_variate || estimator.antithetic || estimator.importance
+                    || gauss_config.moment_match || (strata_count > 0 && estimator.latin_hypercube))) {
+        if(rank == 0) std::cerr << "Error: --stratify and --lhs do not combine with each other, --qmc, --rqmc, --cv,"
+                                << " --antithetic, --importance or --moment-match." << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    // Adaptive stopping takes the runs as independent samples of the price:
+    // not the QMC blocks, nor the per run estimates of the control variate
+    // (biased beta) and of the strata (only pooled over the runs)
+    if (stop_rule.active() && (gauss_config.qmc || estimator.control_variate || strata_count > 0)) {
+        if(rank == 0) std::cerr << "Error: --target-stderr and --deadline do not combine with --qmc, --rqmc, --cv"
+                                << " or --stratify." << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    // MLMC has its own time-stepped kernel, in double on the Philox stream
+    // (the tiles seek their slice of it) with one uniform per normal
+    const bool mlmc_mode = mlmc_epsilon > 0.0;
+    if (mlmc_mode && (gauss_config.qmc || estimator.control_variate || estimator.antithetic || estimator.importance
+                      || sampled || gauss_config.moment_match || stop_rule.active() || engine != "philox"
+                      || gauss_config.method == GaussMethod::Ziggurat || precision != Precision::Double)) {
+        if(rank == 0) std::cerr << "Error: --mlmc only combines with --gauss boxmuller|icdf, --icdf, --seed and --tile."
+                                << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    // The option book prices from the plain terminal draws, in double
+    const bool book_mode = book_strikes > 0;
+    if (book_mode && (replicates > 1 || estimator.control_variate || estimator.antithetic || estimator.importance
+                      || sampled || stop_rule.active() || mlmc_mode || precision != Precision::Double)) {
+        if(rank == 0) std::cerr << "Error: --book does not combine with --rqmc, --cv, --antithetic, --importance,"
+                                << " --stratify, --lhs, --target-stderr, --deadline, --mlmc or --precision float|mixed."
+                                << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    // A portfolio is priced like a book, on the Philox stream so that a
+    // contract's price does not depend on where it is priced
+    const bool portfolio_mode = !portfolio_path.empty();
+    if (portfolio_mode && (replicates > 1 || estimator.control_variate || estimator.antithetic || estimator.importance
+                           || sampled || stop_rule.active() || mlmc_mode || book_mode || engine != "philox"
+                           || precision != Precision::Double)) {
+        if(rank == 0) std::cerr << "Error: --portfolio only combines with --pricer, --gauss, --icdf, --qmc, --scramble,"
+                                << " --moment-match, --seed, --tile, --output, --chunk and --overwrite." << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Tile and threads (--autotune-scope all: also engine, Gaussian method and
+    // precision) from the tuning cache or a calibration sweep (tune.h), they
+    // replace the options above
+    if (tune_mode != "off" && bench_mode.empty() && pricer == "mc" && !sampled && !mlmc_mode && !book_mode
+        && !portfolio_mode) {
+        // Only what keeps the price of this --seed, unless asked for more
+        TuneScope scope;
+        scope.results = tune_all;
+        scope.tile = tune_all || (!gauss_config.moment_match && precision == Precision::Double);
+        scope.threads = tune_all || gauss_config.qmc || engine == "philox";
+        std::string scope_name = "all";
+        if (!tune_all)
+            scope_name = "layout " + engine + " " + tune::method_name(gauss_config.method) + " "
+                         + tune::precision_name(precision) + (gauss_config.moment_match ? " matched" : "");
+        const std::string key = tune::key(size, gauss_config.qmc, scope_name);
+        TuneConfig tuned;
+        tuned.engine = engine;
+        tuned.method = gauss_config.method;
+        tuned.precision = precision;
+        tuned.tile = tile;
+        tuned.threads = omp_get_max_threads();
+        // Rank 0 reads the cache, every rank gets its entry
+        char entry[256] = {0};
+        if (tune_mode == "auto" && rank == 0 && tune::load(tune_cache, key, tuned))
+            std::snprintf(entry, sizeof(entry), "%s", tune::to_string(tuned).c_str());
+        MPI_Bcast(entry, sizeof(entry), MPI_CHAR, 0, MPI_COMM_WORLD);
+        bool cached = tune::from_string(entry, tuned);
+        if (!cached) {
+            if (rank == 0) std::cout << "Tuning for " << key << std::endl;
+            int max_threads = omp_get_max_threads();
+            tuned = tune::sweep(tuned, scope, gauss_config.qmc, max_threads,
+                                [&](const TuneConfig& c) {
+                                    return calibration_seconds(c, rank, max_threads, gauss_config, plan, estimator);
+                                }, rank == 0);
+            if (rank == 0 && !tune::save(tune_cache, key, tuned))
+                std::cerr << "Warning: could not write the tuning cache " << tune_cache << std::endl;
+        }
+        if (scope.results) {
+            engine = tuned.engine;
+            gauss_config.method = tuned.method;
+            precision = tuned.precision;
+        }
+        if (scope.tile) tile = tuned.tile;
+        if (scope.threads) omp_set_num_threads(tuned.threads);
+        if (rank == 0)
+            std::cout << "Tuned configuration (" << (cached ? "cache " : "sweep, saved in ") << tune_cache << "): "
+                      << "rng " << engine << " gauss " << tune::method_name(gauss_config.method)
+                      << " precision " << tune::precision_name(precision) << " tile " << tile
+                      << " threads " << omp_get_max_threads() << std::endl;
+    }
+    // The strata are placed on the uniforms, the normals come from the inverse CDF
+    if (sampled) gauss_config.method = GaussMethod::InverseCDF;
+    gauss_config.single = precision != Precision::Double;
+    // Built once before the timing, shared read-only by all the threads
+    if (gauss_config.method == GaussMethod::Ziggurat) ziggurat::tables();
 
     ui64 num_simulations = std::stoull(argv[1]);
     ui64 num_runs        = std::stoull(argv[2]);
@@ -117,39 +1085,312 @@ int main(int argc, char* argv[]) {
         MPI_Finalize();
         return 1;
     }
+    if (gauss_config.qmc && num_runs * num_simulations > sobol::MAX_POINTS) {
+        if(rank == 0) std::cerr << "Error: QMC is limited to " << sobol::MAX_POINTS << " points in total." << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
     if(rank==0)
 	    std::cout << "Number of process MPI: " << size << "\n";
-    ui64 num_sims = num_simulations/size;
-    ui64 simulations_per_process = ( rank == size - 1 ) ? num_simulations - num_sims * rank :
+    // Replicates: the ranks are split in groups, each group prices with its
+    // own scrambling of the point set (randomized QMC). Without --rqmc there
+    // is a single group holding all the ranks.
+    int group = (int)((long)rank * replicates / size);
+    MPI_Comm group_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, group, rank, &group_comm);
+    int group_rank, group_size;
+    MPI_Comm_rank(group_comm, &group_rank);
+    MPI_Comm_size(group_comm, &group_size);
+    gauss_config.replicate = group;
+    // Same work per rank as without replicates
+    ui64 group_simulations = num_simulations * group_size / size;
+    // Antithetic: whole pairs of paths in every slice
+    if (estimator.antithetic) group_simulations &= ~(ui64)1;
+    if (strata_count > 0) {
+        if (group_simulations < 2 * (ui64)strata_count) {
+            if(rank == 0) std::cerr << "Error: --stratify needs at least 2 paths per stratum." << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+        estimator.strata = stratify::make(strata_count, group_simulations, allocation, plan);
+    }
+    estimator.paths_per_run = group_simulations;
+    // Slices are whole tiles: a tile covers the same paths of the run whatever
+    // the number of ranks, so its sum (reduce.h) does not depend on it either
+    ui64 num_sims = group_simulations/group_size/tile*tile;
+    ui64 simulations_per_process = ( group_rank == group_size - 1 ) ? group_simulations - num_sims * group_rank :
 	    num_sims;
     // To ensure at least num_simulations in total
     // But since we do more
 
-    // Input parameters
-    ui64 S0      = 100;                   // Initial stock price
-    ui64 K       = 110;                   // Strike price
-    double T     = 1.0;                   // Time to maturity (1 year)
-    double r     = 0.06;                  // Risk-free interest rate
-    double sigma = 0.2;                   // Volatility
-    double q     = 0.03;                  // Dividend yield
-
-    // Generate a random seed at the start of the program using random_device
-    std::random_device rd;
-    unsigned long long global_seed = rd();  // This will be the global seed
+    // Generate a random seed at the start of the program using random_device,
+    // unless --seed is given. It is the only source of entropy: every stream
+    // is derived from it (seed.h), so the same seed gives the same result.
+    if (!fixed_seed && rank == 0) {
+        std::random_device rd;
+        global_seed = rd();  // This will be the global seed
+    }
+    MPI_Bcast(&global_seed, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
     if(rank == 0){
         std::cout << "Global initial seed: " << global_seed << "      argv[1]= " << argv[1] << "     argv[2]= " << argv[2] <<  std::endl;
     }
-    double local_sum=0.0;
-    double global_sum=0.0;
+    if (!bench_mode.empty()) {
+        // <num_simulations> draws / points per measurement
+        if (rank == 0 && bench_mode == "rng") bench::rng(global_seed, num_simulations);
+        if (rank == 0 && bench_mode == "math") bench::math(num_simulations);
+        if (rank == 0 && bench_mode == "closed") bench::closed(global_seed, num_simulations);
+        MPI_Comm_free(&group_comm);
+        MPI_Finalize();
+        return 0;
+    }
+    // Portfolio file: <num_simulations> x <num_runs> paths per contract, or
+    // the closed form with --pricer auto. A CSV is first converted by rank 0
+    // into the binary format next to it.
+    if (portfolio_mode) {
+        std::string binary_path = portfolio_path, error;
+        bool is_csv = portfolio_path.size() > 4 && portfolio_path.compare(portfolio_path.size() - 4, 4, ".csv") == 0;
+        if (is_csv) binary_path = portfolio_path.substr(0, portfolio_path.size() - 4) + ".bin";
+        int imported = 1;
+        if (is_csv && rank == 0) imported = portfolio::import_csv(portfolio_path, binary_path, overwrite, error);
+        MPI_Bcast(&imported, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MappedPortfolio file;
+        int opened = imported && file.open(binary_path, error), all_opened;
+        MPI_Allreduce(&opened, &all_opened, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        // Records checked once, by rank 0, and already by the CSV import
+        int checked = all_opened && (is_csv || rank != 0 || file.check(error));
+        MPI_Bcast(&checked, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        all_opened = all_opened && checked;
+        MPI_File out;
+        int created = all_opened && MPI_File_open(MPI_COMM_WORLD, output_path.c_str(),
+                                                  MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                                                  &out) == MPI_SUCCESS;
+        if (!all_opened || !created) {
+            if (rank == 0 && !error.empty()) std::cerr << "Error: " << error << std::endl;
+            else if (rank == 0 && !all_opened)
+                std::cerr << "Error: cannot open " << binary_path << " on every rank" << std::endl;
+            else if (rank == 0) std::cerr << "Error: cannot write " << output_path << std::endl;
+            MPI_Finalize();
+            return 1;
+        }
+        MPI_File_set_size(out, 0);
+        double seconds = price_portfolio(file, out, global_seed, rank, size, gauss_config, num_runs, num_simulations,
+                                         tile, chunk, pricer == "auto");
+        MPI_File_close(&out);
+        double slowest;
+        MPI_Reduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0)
+            std::cout << std::fixed << std::setprecision(6) << " portfolio: " << file.size() << " contracts"
+                      << (is_csv ? " (imported to " + binary_path + ")" : std::string()) << " priced in " << slowest
+                      << " seconds" << (pricer == "auto" ? " (closed form)" : "") << std::scientific
+                      << std::setprecision(3) << ", " << file.size() / slowest << " contracts/s, written to "
+                      << output_path << std::endl;
+        reduce::mpi_free();
+        MPI_Comm_free(&group_comm);
+        MPI_Finalize();
+        return 0;
+    }
+    // The European call has a closed form: with --pricer auto it is the
+    // price, the simulation is skipped
+    if (pricer == "auto") {
+        double t1=dml_micros();
+        double value = closed_form::call(plan);
+        double t2=dml_micros();
+        if (rank == 0)
+            std::cout << std::fixed << std::setprecision(6) << " value= " << value << " in " << (t2-t1)/1000000.0
+                      << " seconds (closed form)" << std::endl;
+        MPI_Comm_free(&group_comm);
+        MPI_Finalize();
+        return 0;
+    }
+    // Multilevel Monte Carlo to an RMS error epsilon, <num_simulations> is the
+    // pilot sample of every level and <num_runs> is not used
+    if (mlmc_mode) {
+        mlmc::Problem problem = {(double)S0, (double)K, T, r - q, sigma, plan.discount};
+        mlmc::Config config;
+        config.epsilon = mlmc_epsilon;
+        config.unit = tile;
+        config.pilot = std::max<ui64>((num_simulations + tile - 1) / tile, 1) * tile;
+        double t1=dml_micros();
+        mlmc::Result result = mlmc::estimate(config,
+                                             [&](const std::vector<uint64_t>& first, const std::vector<uint64_t>& count,
+                                                 std::vector<mlmc::LevelSums>& sums) {
+                                                 mlmc_sample(global_seed, rank, size, gauss_config, problem, tile,
+                                                             first, count, sums);
+                                             }, rank == 0);
+        double t2=dml_micros();
+        if (rank == 0) {
+            for (size_t l = 0; l < result.samples.size(); ++l)
+                std::cout << "  level " << std::setw(2) << l << "  samples " << std::setw(12) << result.samples[l]
+                          << std::scientific << std::setprecision(4) << "  mean " << std::setw(11) << result.mean[l]
+                          << "  variance " << result.variance[l] << std::defaultfloat << std::endl;
+            std::cout << std::fixed << std::setprecision(6) << " value= " << result.price << " in "
+                      << (t2-t1)/1000000.0 << " seconds (MLMC, " << result.samples.size() << " levels)" << std::endl;
+            double exact = closed_form::call(plan);
+            std::cout << std::fixed << std::setprecision(6) << " closed form= " << exact << " error= " << std::showpos
+                      << result.price - exact << std::noshowpos << std::endl;
+            std::cout << std::setprecision(8) << " stderr= " << result.stderr_value << std::setprecision(2)
+                      << " alpha= " << result.alpha << " beta= " << result.beta << std::scientific
+                      << " cost= " << result.cost << " steps (plain MC at the finest level " << result.plain_cost
+                      << ", x" << std::fixed << std::setprecision(1) << result.plain_cost / result.cost << ")"
+                      << std::endl;
+            if (!result.converged)
+                std::cout << " Warning: the bias is still above the target at the maximum level" << std::endl;
+        }
+        reduce::mpi_free();
+        MPI_Comm_free(&group_comm);
+        MPI_Finalize();
+        return 0;
+    }
+    ui64 first_point = group_rank * num_sims;
+    // Option book: a strike ladder of the contract's underlying, every
+    // contract priced on the same num_runs x num_simulations draws
+    if (book_mode) {
+        OptionBook options = book::ladder(book_strikes, book_maturities, (double)S0, T, r, sigma, q);
+        std::vector<CompensatedSum> local_sums, book_sums(2 * options.size());
+        double t1=dml_micros();
+        dispatch_book(engine, global_seed, rank, gauss_config, num_runs, first_point, group_simulations,
+                      simulations_per_process, options, tile, local_sums);
+        MPI_Reduce(local_sums.data(), book_sums.data(), (int)local_sums.size(), reduce::mpi_type(),
+                   reduce::mpi_sum(), 0, group_comm);
+        double t2=dml_micros();
+        if (rank == 0) {
+            double n = (double)num_runs * group_simulations;
+            double squares = 0.0, variances = 0.0;
+            std::vector<size_t> at(options.size());
+            for (size_t j = 0; j < options.size(); ++j) at[options.id[j]] = j;
+            for (size_t i = 0; i < options.size(); ++i) {
+                size_t j = at[i];
+                const PricingPlan& contract = make_pricing_plan(options.S0[j], options.K[j], options.T[j],
+                                                                options.r[j], options.sigma[j], options.q[j]);
+                double mean = book_sums[2 * j].value() / n;
+                double var = n > 1.0 ? std::max(book_sums[2 * j + 1].value() / n - mean * mean, 0.0) * n / (n - 1)
+                                     : 0.0;
+                double value = contract.discount * mean, stderr_value = contract.discount * std::sqrt(var / n);
+                double exact = closed_form::price(contract.forward, contract.K, contract.diffusion, contract.discount,
+                                                  options.sign[j] > 0.0);
+                squares += (value - exact) * (value - exact);
+                variances += stderr_value * stderr_value;
+                if (i < 16)
+                    std::cout << std::fixed << std::setprecision(6) << "  " << (options.sign[j] > 0.0 ? "call" : "put ")
+                              << " K= " << std::setw(10) << options.K[j] << " T= " << options.T[j] << " value= "
+                              << value << " stderr= " << stderr_value << " closed form= " << exact << std::endl;
+            }
+            std::cout << std::fixed << std::setprecision(6) << " book: " << options.size() << " contracts in "
+                      << options.groups() << " groups, " << (ui64)n << " paths each in " << (t2-t1)/1000000.0
+                      << " seconds, " << std::scientific << std::setprecision(3)
+                      << n * options.size() / ((t2-t1)/1000000.0) << " payoffs/s" << std::endl;
+            // About 1 when the errors are the sampling noise (a per contract ratio
+            // is meaningless for the far out of the money ones, hit by a few paths)
+            std::cout << std::scientific << std::setprecision(3) << " rms error= "
+                      << std::sqrt(squares / options.size()) << " rms stderr= "
+                      << std::sqrt(variances / options.size()) << std::endl;
+        }
+        reduce::mpi_free();
+        MPI_Comm_free(&group_comm);
+        MPI_Finalize();
+        return 0;
+    }
+    // One slot per run, summed in run order afterwards: the result does not
+    // depend on the order in which the threads finish
+    std::vector<Moments> run_sums(num_runs);
+    std::vector<CompensatedSum> stratum_sums;
     double t1=dml_micros();
-    #pragma omp parallel for reduction(+:local_sum)
-    for (ui64 run = 0; run < num_runs; ++run) {
-        local_sum+= black_scholes_monte_carlo(S0, K, T, r, sigma, q, simulations_per_process);
+    // Adaptive: num_runs is the maximum, it becomes the number of runs done
+    const ui64 max_runs = num_runs;
+    Welford adaptive_stats;
+    adaptive::Stop stop = adaptive::Stop::Running;
+    if (stop_rule.active()) {
+        run_sums.clear();
+        stop = adaptive_runs(engine, global_seed, rank, gauss_config, max_runs, first_point, group_simulations,
+                             simulations_per_process, plan, precision, tile, estimator, stop_rule, t_start,
+                             group_comm, run_sums, adaptive_stats);
+        num_runs = run_sums.size();
     }
-    MPI_Reduce(&local_sum, &global_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    else
+        dispatch_runs(engine, global_seed, rank, gauss_config, 0, num_runs, first_point, group_simulations,
+                      simulations_per_process, plan, precision, tile, estimator, run_sums, stratum_sums);
+    Moments local_sum;
+    for (ui64 run = 0; run < num_runs; ++run)
+        local_sum.merge(run_sums[run]);
+    // Price of each replicate on its group leader, the compensated pairs are
+    // merged in rank order
+    Moments group_sum;
+    MPI_Reduce(&local_sum, &group_sum, Moments::PAIRS, reduce::mpi_type(), reduce::mpi_sum(), 0, group_comm);
+    // Stratified: the sums of every stratum; Latin hypercube: the sum of every
+    // run, each run is one replicate of the hypercube
+    std::vector<CompensatedSum> group_strata(stratum_sums.size());
+    if (estimator.strata.count > 0)
+        MPI_Reduce(stratum_sums.data(), group_strata.data(), (int)stratum_sums.size(), reduce::mpi_type(),
+                   reduce::mpi_sum(), 0, group_comm);
+    std::vector<CompensatedSum> local_runs, group_runs;
+    if (estimator.latin_hypercube) {
+        local_runs.resize(num_runs);
+        group_runs.resize(num_runs);
+        for (ui64 run = 0; run < num_runs; ++run)
+            local_runs[run] = run_sums[run].y;
+        MPI_Reduce(local_runs.data(), group_runs.data(), (int)num_runs, reduce::mpi_type(), reduce::mpi_sum(), 0,
+                   group_comm);
+    }
+    CompensatedSum replicate_stats[2];
+    Estimate group_estimate = {};
+    if (group_rank == 0) {
+        double samples = (double)num_runs * group_simulations / (estimator.antithetic ? 2 : 1);
+        group_estimate = estimate(group_sum, samples, plan.discount, estimator);
+        // The weighted paths against the exact variance of the unweighted payoff
+        if (estimator.importance)
+            group_estimate.plain_stderr = plan.discount * std::sqrt(closed_form::call_payoff_variance(plan) / samples);
+        if (estimator.strata.count > 0)
+            group_estimate = estimate_stratified(group_strata.data(), estimator.strata, (double)num_runs, plan.discount,
+                                                 closed_form::call_payoff_variance(plan));
+        else if (estimator.latin_hypercube)
+            group_estimate = estimate_replicates(group_runs, (double)group_simulations, plan.discount,
+                                                 closed_form::call_payoff_variance(plan));
+        double mean = group_estimate.price;
+        replicate_stats[0].add(mean);
+        replicate_stats[1].add(mean * mean);
+    }
+    // (sum, sumsq) of the replicate prices on rank 0
+    CompensatedSum global_stats[2];
+    MPI_Reduce(replicate_stats, global_stats, 2, reduce::mpi_type(), reduce::mpi_sum(), 0, MPI_COMM_WORLD);
     double t2=dml_micros();
-    if( rank == 0)
-    	std::cout << std::fixed << std::setprecision(6) << " value= " << global_sum/(num_runs * size) << " in " << (t2-t1)/1000000.0 << " seconds" << std::endl;
+    if( rank == 0) {
+        double value = global_stats[0].value() / replicates;
+    	std::cout << std::fixed << std::setprecision(6) << " value= " << value << " in " << (t2-t1)/1000000.0 << " seconds" << std::endl;
+        // Error against the analytical Black-Scholes-Merton price
+        double exact = closed_form::call(plan);
+        std::cout << std::fixed << std::setprecision(6) << " closed form= " << exact << " error= " << std::showpos
+                  << value - exact << std::noshowpos << std::endl;
+        // Standard error of the first replicate from its own paths (with QMC
+        // the points are not independent, only the replicates give one)
+        if ((estimator.control_variate || estimator.antithetic || estimator.importance || sampled) && !gauss_config.qmc) {
+            std::cout << std::setprecision(8) << " stderr= " << group_estimate.stderr_value
+                      << " (plain MC on as many paths " << group_estimate.plain_stderr << ", variance / "
+                      << std::setprecision(1) << std::pow(group_estimate.plain_stderr / group_estimate.stderr_value, 2)
+                      << ")";
+            if (estimator.control_variate)
+                std::cout << std::setprecision(8) << " control variate beta= " << group_estimate.beta;
+            if (estimator.importance)
+                std::cout << std::setprecision(6) << " importance shift= " << estimator.shift;
+            std::cout << std::endl;
+        }
+        if (stop_rule.active())
+            std::cout << std::setprecision(8) << " adaptive: " << num_runs << " of " << max_runs << " runs, stderr= "
+                      << adaptive_stats.stderr_value() << " over the run prices, stopped on "
+                      << adaptive::stop_name(stop) << std::endl;
+        if (replicates > 1) {
+            // Student t quantile at 97.5% for replicates-1 degrees of freedom
+            static const double t975[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+            double var = std::max(global_stats[1].value() - replicates * value * value, 0.0) / (replicates - 1);
+            double stderr_value = sqrt(var / replicates);
+            double t = replicates - 1 <= 30 ? t975[replicates - 2] : 1.96;
+            std::cout << " stderr= " << std::setprecision(8) << stderr_value << " 95% CI= [" << value - t * stderr_value
+                      << ", " << value + t * stderr_value << "] over " << replicates << " replicates" << std::endl;
+        }
+    }
+    reduce::mpi_free();
+    MPI_Comm_free(&group_comm);
     MPI_Finalize(); 
     return 0;
 }
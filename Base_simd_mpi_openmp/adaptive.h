@@ -0,0 +1,91 @@
+/*
+    Adaptive stopping (--target-stderr <price>, --deadline <seconds>).
+
+    <num_runs> becomes the maximum number of runs. The runs are priced in
+    rounds of the same size on every rank; the sums of the runs of round k
+    are reduced across the ranks (MPI_Iallreduce with the compensated sum of
+    reduce.h) while round k+1 is priced, then the price of every run of
+    round k goes, in run order, into a Welford accumulator (count, mean,
+    M2) of the run prices. All the ranks hold the same accumulator and the
+    slowest rank's time, so they take the same decision at the same round:
+
+      target   : stderr of the mean of the run prices <= target, after at
+                 least MIN_RUNS runs so that the estimate of the stderr
+                 itself is not noise
+      deadline : the next round would end past the deadline (counted from
+                 the start of the program), predicted from the mean time
+                 of a round so far
+
+    The round in flight when the rule is met is kept, it is already paid
+    for. A run is a whole independent estimate of the price (any estimator
+    that prices each run on its own paths: plain, antithetic, importance,
+    moment matching, Latin hypercube), so the runs are the samples and the
+    stderr needs no pooled moment. A run's paths are spread over the ranks,
+    so its price only exists after the reduction: the accumulator is fed
+    there and not per thread, which also keeps the result independent of
+    the number of ranks for a given number of runs.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Streaming mean and variance, one sample at a time
+struct Welford {
+    double count = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;    // sum of the squared deviations from the mean
+
+    void add(double x) {
+        count += 1.0;
+        double delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+    double variance() const { return count > 1.0 ? m2 / (count - 1.0) : 0.0; }
+    double stderr_value() const { return count > 0.0 ? std::sqrt(variance() / count) : 0.0; }
+};
+
+namespace adaptive {
+
+// Runs before the stderr is trusted
+constexpr uint64_t MIN_RUNS = 16;
+// Paths of a round (all the ranks), a few tens of ms on a node: fine enough
+// for a deadline, long enough to hide the reduction
+constexpr uint64_t ROUND_PATHS = 1ull << 24;
+
+enum class Stop { Running, Target, Deadline, MaxRuns };
+
+inline const char* stop_name(Stop s) {
+    static const char* const NAMES[] = {"running", "target stderr", "deadline", "max runs"};
+    return NAMES[(int)s];
+}
+
+struct Rule {
+    double target_stderr = 0.0; // 0: none
+    double deadline = 0.0;      // seconds, 0: none
+
+    bool active() const { return target_stderr > 0.0 || deadline > 0.0; }
+};
+
+// Runs per round: a multiple of the threads of a rank (the runs of a round
+// are shared among them), at least ROUND_PATHS paths
+inline uint64_t round_runs(uint64_t paths_per_run, int threads) {
+    uint64_t per_thread = (ROUND_PATHS + paths_per_run * threads - 1) / (paths_per_run * threads);
+    return (uint64_t)threads * std::max<uint64_t>(per_thread, 1);
+}
+
+// Decision on the reduced rounds, `elapsed` seconds at the end of the last
+// of them and round_seconds their mean time; one more round is already priced
+inline Stop check(const Rule& rule, const Welford& runs, double elapsed, double round_seconds, uint64_t done,
+                  uint64_t max_runs) {
+    if (rule.target_stderr > 0.0 && runs.count >= MIN_RUNS && runs.stderr_value() <= rule.target_stderr)
+        return Stop::Target;
+    // The round in flight and the next one
+    if (rule.deadline > 0.0 && elapsed + 2.0 * round_seconds > rule.deadline) return Stop::Deadline;
+    if (done >= max_runs) return Stop::MaxRuns;
+    return Stop::Running;
+}
+
+} // namespace adaptive
@@ -0,0 +1,188 @@
+/*
+    Micro benchmarks run by --bench (rank 0, one thread), outside the pricing.
+
+      --bench rng  : uniforms/s of every engine of rng.h, then normals/s of
+                     every (engine, Gaussian method) pair, on n draws
+      --bench math : max ulp error of simd_math exp/log (scalar kernels and
+                     exp_array/log_array) against libm on n points of their
+                     range, and evaluations/s of both
+      --bench closed : options/s of the closed-form batch pricer on n random
+                     contracts, max error against a libm (std::erfc) version
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "rng.h"
+#include "gaussian.h"
+#include "simd_math.h"
+#include "closed_form.h"
+
+double dml_micros();
+
+namespace bench {
+
+// Draws per call, the size of the pricing kernel block
+constexpr size_t BLOCK = 512;
+
+// Keeps the compiler from dropping the generated values
+inline double checksum(const double* x, size_t n) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; ++i) s += x[i];
+    return s;
+}
+
+template <class Engine>
+void rng_engine(uint64_t global_seed, uint64_t n) {
+    alignas(64) double buf[BLOCK];
+    volatile double sink = 0.0;
+    Engine engine(global_seed, 0, 0);
+    engine.start_run(0);
+    double t1 = dml_micros();
+    for (uint64_t done = 0; done < n; done += BLOCK) {
+        engine.uniforms(buf, BLOCK);
+        sink = sink + buf[0];
+    }
+    double t2 = dml_micros();
+    std::cout << std::setw(10) << Engine::name << std::setw(12) << "uniform"
+              << std::setw(10) << std::setprecision(1) << n / (t2 - t1) << " M/s" << std::endl;
+
+    static const GaussMethod methods[3] = {GaussMethod::BoxMuller, GaussMethod::Ziggurat, GaussMethod::InverseCDF};
+    static const char* method_names[3] = {"boxmuller", "ziggurat", "icdf"};
+    for (int m = 0; m < 3; ++m) {
+        GaussConfig config;
+        config.method = methods[m];
+        GaussianStream<Engine> gauss(global_seed, 0, 0, config);
+        gauss.start_run(0);
+        t1 = dml_micros();
+        for (uint64_t done = 0; done < n; done += BLOCK) {
+            gauss.fill_gaussians(buf, BLOCK);
+            sink = sink + checksum(buf, 4);
+        }
+        t2 = dml_micros();
+        std::cout << std::setw(10) << Engine::name << std::setw(12) << method_names[m]
+                  << std::setw(10) << std::setprecision(1) << n / (t2 - t1) << " M/s" << std::endl;
+    }
+}
+
+inline void rng(uint64_t global_seed, uint64_t n) {
+    ziggurat::tables();
+    std::cout << std::fixed << "RNG throughput, " << n << " draws per line" << std::endl;
+    rng_engine<PhiloxEngine>(global_seed, n);
+    rng_engine<Xoshiro256pp>(global_seed, n);
+    rng_engine<Mt19937Engine>(global_seed, n);
+    rng_engine<SfmtEngine>(global_seed, n);
+}
+
+// Distance in representable numbers between two finite values, the bits are
+// mapped to a monotonic integer scale so that -0 and +0 are neighbours
+inline uint64_t ulp_distance(double a, double b) {
+    int64_t x = (int64_t)simd_math::as_bits(a), y = (int64_t)simd_math::as_bits(b);
+    x = x < 0 ? INT64_MIN - x : x;
+    y = y < 0 ? INT64_MIN - y : y;
+    return x > y ? (uint64_t)x - (uint64_t)y : (uint64_t)y - (uint64_t)x;
+}
+inline uint64_t ulp_distance(float a, float b) {
+    int32_t x = (int32_t)simd_math::as_bits(a), y = (int32_t)simd_math::as_bits(b);
+    x = x < 0 ? INT32_MIN - x : x;
+    y = y < 0 ? INT32_MIN - y : y;
+    return x > y ? (uint64_t)(x - y) : (uint64_t)(y - x);
+}
+
+// Compares f (scalar kernel) and f_array (vector kernel) to the reference
+// on n points spread over [lo, hi], log-spaced when log_spaced
+template <typename Real, class Ref, class F, class FArray>
+void math_function(const char* name, Real lo, Real hi, bool log_spaced, uint64_t n,
+                   Ref ref, F f, FArray f_array) {
+    std::vector<Real> x(n), y_ref(n), y_scalar(n), y_vec(n);
+    for (uint64_t i = 0; i < n; ++i) {
+        double a = (double)i / (double)(n - 1);
+        x[i] = log_spaced ? (Real)std::exp(std::log((double)lo) + (std::log((double)hi) - std::log((double)lo)) * a)
+                           : (Real)(lo + (hi - lo) * a);
+    }
+    double t1 = dml_micros();
+    for (uint64_t i = 0; i < n; ++i) y_ref[i] = ref(x[i]);
+    double t2 = dml_micros();
+    #pragma omp simd
+    for (uint64_t i = 0; i < n; ++i) y_scalar[i] = f(x[i]);
+    double t3 = dml_micros();
+    f_array(x.data(), y_vec.data(), n);
+    double t4 = dml_micros();
+    uint64_t err_scalar = 0, err_vec = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        err_scalar = std::max(err_scalar, ulp_distance(y_scalar[i], y_ref[i]));
+        err_vec = std::max(err_vec, ulp_distance(y_vec[i], y_ref[i]));
+    }
+    std::cout << std::setw(10) << name << "  max ulp scalar " << std::setw(2) << err_scalar
+              << " array " << std::setw(2) << err_vec << std::setprecision(1)
+              << "   libm " << std::setw(7) << n / (t2 - t1) << " M/s  simd " << std::setw(7) << n / (t3 - t2)
+              << " M/s  array " << std::setw(7) << n / (t4 - t3) << " M/s" << std::endl;
+}
+
+inline void math(uint64_t n) {
+    n = std::max<uint64_t>(n, 2);
+    std::cout << std::fixed << "simd_math against libm, " << n << " points per line" << std::endl;
+    // Float references are the double results rounded, i.e. correctly rounded
+    math_function<double>("exp", simd_math::EXP_MIN, simd_math::EXP_MAX, false, n,
+                          [](double x) { return std::exp(x); },
+                          [](double x) { return simd_math::exp(x); },
+                          [](const double* x, double* y, size_t m) { simd_math::exp_array(x, y, m); });
+    math_function<float>("expf", simd_math::EXPF_MIN, simd_math::EXPF_MAX, false, n,
+                         [](float x) { return (float)std::exp((double)x); },
+                         [](float x) { return simd_math::exp(x); },
+                         [](const float* x, float* y, size_t m) { simd_math::exp_array(x, y, m); });
+    math_function<double>("log", 1e-300, 1e300, true, n,
+                          [](double x) { return std::log(x); },
+                          [](double x) { return simd_math::log(x); },
+                          [](const double* x, double* y, size_t m) { simd_math::log_array(x, y, m); });
+    math_function<float>("logf", 1e-37f, 1e37f, true, n,
+                         [](float x) { return (float)std::log((double)x); },
+                         [](float x) { return simd_math::log(x); },
+                         [](const float* x, float* y, size_t m) { simd_math::log_array(x, y, m); });
+}
+
+// Black-Scholes price with libm only, the reference of --bench closed
+inline double libm_call(double S0, double K, double T, double r, double sigma, double q) {
+    double v = sigma * std::sqrt(T);
+    double d1 = (std::log(S0 / K) + (r - q) * T + 0.5 * v * v) / v;
+    double d2 = d1 - v;
+    return S0 * std::exp(-q * T) * 0.5 * std::erfc(-d1 / std::sqrt(2.0))
+         - K * std::exp(-r * T) * 0.5 * std::erfc(-d2 / std::sqrt(2.0));
+}
+
+inline void closed(uint64_t global_seed, uint64_t n) {
+    n = std::max<uint64_t>(n, 1);
+    // Random book in structure of arrays layout, from deep out to deep in the money
+    std::vector<double> S0(n), K(n), T(n), r(n), sigma(n), q(n), price(n), ref(n);
+    PhiloxEngine engine(global_seed, 0, 0);
+    engine.start_run(0);
+    std::vector<double> u(6 * n);
+    engine.uniforms(u.data(), 6 * n);
+    for (uint64_t i = 0; i < n; ++i) {
+        S0[i] = 100.0;
+        K[i] = 50.0 + 100.0 * u[6 * i];
+        T[i] = 0.05 + 4.95 * u[6 * i + 1];
+        r[i] = 0.1 * u[6 * i + 2];
+        sigma[i] = 0.05 + 0.75 * u[6 * i + 3];
+        q[i] = 0.05 * u[6 * i + 4];
+    }
+    double t1 = dml_micros();
+    for (uint64_t i = 0; i < n; ++i) ref[i] = libm_call(S0[i], K[i], T[i], r[i], sigma[i], q[i]);
+    double t2 = dml_micros();
+    closed_form::calls(S0.data(), K.data(), T.data(), r.data(), sigma.data(), q.data(), price.data(), n);
+    double t3 = dml_micros();
+    double err = 0.0;
+    for (uint64_t i = 0; i < n; ++i) err = std::max(err, std::fabs(price[i] - ref[i]));
+    std::cout << std::fixed << "Closed-form calls, " << n << " contracts" << std::endl
+              << std::setprecision(1) << "  libm  " << std::setw(8) << n / (t2 - t1) << " M options/s" << std::endl
+              << "  simd  " << std::setw(8) << n / (t3 - t2) << " M options/s   max abs error "
+              << std::scientific << std::setprecision(2) << err << std::endl;
+}
+
+} // namespace bench
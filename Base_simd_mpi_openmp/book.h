@@ -0,0 +1,103 @@
+/*
+    Option book (--book <strikes>x<maturities>): many European calls and
+    puts priced from one shared set of draws.
+
+    The contracts are kept in structure of arrays layout, sorted by group
+    then strike; a group is the contracts of one underlying (S0, r, q,
+    sigma) and one maturity T, which share the terminal value
+
+        S_T = S0 exp(drift + diffusion Z)
+
+    so every terminal normal Z is drawn once for the whole book, the exp is
+    paid once per path and group, and the payoffs of the strike ladder are
+
+        max(w_j (S_T - K_j), 0)      w_j = +1 call, -1 put
+
+    a branch-free loop over the contiguous K_j, w_j that vectorizes. The
+    groups of one underlying at different maturities reuse the same Z:
+    each price is still the expectation of its own payoff, only the errors
+    are correlated across the book.
+
+    id[j] keeps the position of contract j before the sort, the results are
+    reported in the input order.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#include "pricing.h"
+
+struct OptionBook {
+    std::vector<double> S0, K, T, r, sigma, q;
+    std::vector<double> sign;       // +1 call, -1 put
+    std::vector<uint64_t> id;       // input order
+    // Group g is the contracts [first[g], first[g + 1]), plan[g] its terminal law
+    std::vector<size_t> first;
+    std::vector<PricingPlan> plan;
+
+    size_t size() const { return K.size(); }
+    size_t groups() const { return plan.size(); }
+
+    void add(double s0, double k, double t, double rate, double vol, double dividend, bool is_call) {
+        id.push_back(K.size());
+        S0.push_back(s0);
+        K.push_back(k);
+        T.push_back(t);
+        r.push_back(rate);
+        sigma.push_back(vol);
+        q.push_back(dividend);
+        sign.push_back(is_call ? 1.0 : -1.0);
+    }
+
+    // Sorts by (S0, r, q, sigma, T, K) and builds the groups
+    void group() {
+        std::vector<size_t> order(size());
+        std::iota(order.begin(), order.end(), 0);
+        auto key = [&](size_t i) { return std::make_tuple(S0[i], r[i], q[i], sigma[i], T[i], K[i], sign[i], id[i]); };
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+        auto permute = [&](auto& v) {
+            auto copy = v;
+            for (size_t j = 0; j < order.size(); ++j) v[j] = copy[order[j]];
+        };
+        permute(S0);
+        permute(K);
+        permute(T);
+        permute(r);
+        permute(sigma);
+        permute(q);
+        permute(sign);
+        permute(id);
+        first.clear();
+        plan.clear();
+        for (size_t j = 0; j < size(); ++j) {
+            bool same = j > 0 && S0[j] == S0[j - 1] && r[j] == r[j - 1] && q[j] == q[j - 1]
+                        && sigma[j] == sigma[j - 1] && T[j] == T[j - 1];
+            if (same) continue;
+            first.push_back(j);
+            plan.push_back(make_pricing_plan(S0[j], K[j], T[j], r[j], sigma[j], q[j]));
+        }
+        first.push_back(size());
+    }
+};
+
+namespace book {
+
+// Strike ladder of one underlying: strikes from 0.5 to 1.5 S0 at each of
+// `maturities` maturities up to T, out of the money (puts below S0, calls
+// above)
+inline OptionBook ladder(int strikes, int maturities, double S0, double T, double r, double sigma, double q) {
+    OptionBook b;
+    for (int m = 0; m < maturities; ++m)
+        for (int i = 0; i < strikes; ++i) {
+            double K = S0 * (0.5 + (i + 0.5) / strikes);
+            b.add(S0, K, T * (m + 1) / maturities, r, sigma, q, K >= S0);
+        }
+    b.group();
+    return b;
+}
+
+} // namespace book
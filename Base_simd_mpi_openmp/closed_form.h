@@ -0,0 +1,81 @@
+/*
+    Closed-form Black-Scholes-Merton price of European calls and puts.
+
+        F  = S0 exp((r - q) T)          forward
+        v  = sigma sqrt(T)              total volatility
+        d1 = (ln(F/K) + v^2/2) / v      d2 = d1 - v
+        call = exp(-r T) (F Phi(d1) - K Phi(d2))
+        put  = exp(-r T) (K Phi(-d2) - F Phi(-d1))
+
+    Written on scalars with the branch-free exp, log and norm_cdf of
+    simd_math.h, so the batch loops below vectorize (--bench closed gives
+    the options/s). v = 0 (T = 0 or sigma = 0) gives the discounted
+    intrinsic value of the forward.
+
+    It is the reference printed next to every Monte Carlo price, and the
+    pricer itself with --pricer auto for the contracts that have one.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "pricing.h"
+#include "simd_math.h"
+
+namespace closed_form {
+
+// Forward form, shared by the scalar and the batch versions
+SIMD_INLINE double price(double F, double K, double v, double discount, bool is_call) {
+    // v = 0 would give 0/0 in d1, its result is replaced by the intrinsic value
+    double v_safe = v > 0.0 ? v : 1.0;
+    double d1 = (simd_math::log(F / K) + 0.5 * v * v) / v_safe;
+    double d2 = d1 - v;
+    double sign = is_call ? 1.0 : -1.0;
+    double value = sign * (F * simd_math::norm_cdf(sign * d1) - K * simd_math::norm_cdf(sign * d2));
+    double intrinsic = std::max(sign * (F - K), 0.0);
+    return discount * (v > 0.0 ? value : intrinsic);
+}
+
+// Call of a pricing plan, v = diffusion
+inline double call(const PricingPlan& plan) {
+    return price(plan.forward, plan.K, plan.diffusion, plan.discount, true);
+}
+
+// Variance of the undiscounted call payoff Y = max(S_T - K, 0) of a plan:
+// with S_T = S0 e^(drift + v Z), E[e^(aZ); Z > z*] = e^(a^2/2) Phi(a - z*)
+inline double call_payoff_variance(const PricingPlan& plan) {
+    double v = plan.diffusion, z = plan.z_star;
+    double A = plan.S0 * std::exp(plan.drift);
+    double itm = simd_math::norm_cdf(-z);
+    double m1 = A * std::exp(0.5 * v * v) * simd_math::norm_cdf(v - z);
+    double m2 = A * A * std::exp(2.0 * v * v) * simd_math::norm_cdf(2.0 * v - z);
+    double mean = m1 - plan.K * itm;
+    double second = m2 - 2.0 * plan.K * m1 + plan.K * plan.K * itm;
+    return std::max(second - mean * mean, 0.0);
+}
+
+// n contracts in structure of arrays layout, out[i] = price of contract i
+template <bool IsCall>
+inline void batch(const double* S0, const double* K, const double* T, const double* r,
+                  const double* sigma, const double* q, double* out, size_t n) {
+    #pragma omp simd
+    for (size_t i = 0; i < n; ++i) {
+        double F = S0[i] * simd_math::exp((r[i] - q[i]) * T[i]);
+        double v = sigma[i] * std::sqrt(T[i]);
+        out[i] = price(F, K[i], v, simd_math::exp(-r[i] * T[i]), IsCall);
+    }
+}
+
+inline void calls(const double* S0, const double* K, const double* T, const double* r,
+                  const double* sigma, const double* q, double* out, size_t n) {
+    batch<true>(S0, K, T, r, sigma, q, out, n);
+}
+
+inline void puts(const double* S0, const double* K, const double* T, const double* r,
+                 const double* sigma, const double* q, double* out, size_t n) {
+    batch<false>(S0, K, T, r, sigma, q, out, n);
+}
+
+} // namespace closed_form
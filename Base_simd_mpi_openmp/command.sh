@@ -32,7 +32,7 @@ export OMP_NUM_THREADS=$(lscpu | grep '^Core(s) per socket:' | awk '{print $4}'
 nodelist=$(scontrol show hostname $SLURM_NODELIST)
 printf "%s\n " "${nodelist[@]}" > output/nodefile
 
-mpirun --hostfile output/nodefile  ./BSM        100000    1000000
-mpirun --hostfile output/nodefile  ./BSMwithopt 100000    1000000
+mpirun --hostfile output/nodefile  ./BSM        100000    1000000 --seed 2024
+mpirun --hostfile output/nodefile  ./BSMwithopt 100000    1000000 --seed 2024
 #mpirun --hostfile output/nodefile  ./BSMwithopt 10000000  1000000
 #mpirun --hostfile output/nodefile  ./BSMwithopt 100000000 1000000
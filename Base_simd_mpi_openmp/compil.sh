@@ -1,2 +1,2 @@
-mpic++ -O -march=native -larmpl_mp -fopenmp BSM.cxx -o BSM
-mpic++ -O3 -larmpl_mp -march=native -fopenmp BSM.cxx -o BSMwithopt
+mpic++ -O -march=native -fno-math-errno -larmpl_mp -fopenmp BSM.cxx -o BSM
+mpic++ -O3 -fno-math-errno -larmpl_mp -march=native -fopenmp BSM.cxx -o BSMwithopt
@@ -0,0 +1,169 @@
+/*
+    Variance reduction of the Monte Carlo estimator (--cv).
+
+    Control variate: X = S_T - F with F = S0 exp((r - q) T) = E[S_T] known
+    exactly, strongly correlated with the payoff Y = max(S_T - K, 0). The
+    kernel accumulates Y, Y^2, X, X^2 and XY in the same pass (X is already
+    centred, so the second moments do not cancel), and the price is
+
+        Y_cv = mean(Y) - beta mean(X),    beta = Cov(X, Y) / Var(X)
+
+    with its variance (Var(Y) - Cov(X,Y)^2 / Var(X)) / n. beta is estimated
+    on the pooled moments of a whole replicate (all its runs and ranks) and
+    not per tile or per run: a beta fitted on few paths is correlated with
+    their mean and biases the estimate by O(1/paths).
+
+    Antithetic variates (--antithetic): every normal Z gives the two paths
+    Z and -Z, half the draws for the same number of paths. The sample is
+    then the pair mean h = (Y(Z) + Y(-Z)) / 2, whose variance is below
+    Var(Y) / 2 for a monotone payoff; the moments above are those of h
+    (and of the pair mean of X for the control variate, which combines
+    with it), plus the mean of Y^2 over single paths to give the standard
+    error plain Monte Carlo would have on as many paths.
+
+    Importance sampling (--importance auto): for a strike far above S0
+    almost every path pays 0. The normals are drawn from N(mu, 1) instead,
+    mu chosen from the pricing plan as the maximum of payoff(z) phi(z)
+    (the mode of the zero-variance density, always above the log-strike
+    threshold z*), and every payoff is weighted by the likelihood ratio
+    phi(z) / phi(z - mu) = exp(-mu z + mu^2 / 2). The standard error is
+    compared with the exact variance of the unweighted payoff
+    (closed_form::call_payoff_variance).
+
+    Stratified and Latin hypercube sampling (stratify.h) keep one pair of
+    sums per stratum, respectively use the runs as replicates, see
+    estimate_stratified and estimate_replicates.
+
+    The moments are compensated sums (reduce.h) reduced like the plain sum,
+    so the result keeps the same reproducibility.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "pricing.h"
+#include "reduce.h"
+#include "stratify.h"
+
+struct Estimator {
+    bool control_variate = false;
+    bool antithetic = false;
+    bool importance = false;
+    double shift = 0.0;         // mu of the importance sampling
+    Strata strata;              // stratified when strata.count > 0
+    bool latin_hypercube = false;
+    uint64_t paths_per_run = 0; // Latin hypercube points per run
+};
+
+// Mode of payoff(z) phi(z) for the call: d/dz [log(S(z) - K) - z^2/2] = 0,
+// i.e. v S(z) / (S(z) - K) = z, decreasing from +inf at z* so bisection
+inline double importance_shift(const PricingPlan& plan) {
+    double v = plan.diffusion;
+    if (!(v > 0.0)) return 0.0;
+    double lo = std::max(plan.z_star, -40.0), hi = std::max(plan.z_star, 0.0) + v + 10.0;
+    for (int i = 0; i < 200 && hi - lo > 1e-12; ++i) {
+        double z = 0.5 * (lo + hi);
+        double S = plan.S0 * std::exp(plan.drift + v * z);
+        double g = S > plan.K ? v * S / (S - plan.K) - z : 1.0;
+        (g > 0.0 ? lo : hi) = z;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Undiscounted sums over the samples (paths, or pairs of paths when
+// antithetic); the plain kernels only fill y
+struct Moments {
+    CompensatedSum y, yy, x, xx, xy;
+    CompensatedSum single_yy;   // antithetic: sum of (Y(Z)^2 + Y(-Z)^2) / 2
+
+    // Number of reduce::mpi_type() pairs sent to MPI
+    static constexpr int PAIRS = 6;
+
+    void merge(const Moments& other) {
+        y.merge(other.y);
+        yy.merge(other.yy);
+        x.merge(other.x);
+        xx.merge(other.xx);
+        xy.merge(other.xy);
+        single_yy.merge(other.single_yy);
+    }
+};
+static_assert(sizeof(Moments) == Moments::PAIRS * sizeof(CompensatedSum), "Moments must be contiguous pairs");
+
+struct Estimate {
+    double price;           // discounted
+    double stderr_value;    // of price, with the variance reduction
+    double plain_stderr;    // of plain Monte Carlo on as many paths
+    double beta;
+};
+
+// n samples: paths, or pairs of paths when antithetic
+inline Estimate estimate(const Moments& m, double n, double discount, const Estimator& estimator) {
+    Estimate e;
+    double mean_y = m.y.value() / n;
+    double var_y = std::max(m.yy.value() / n - mean_y * mean_y, 0.0) * n / (n - 1);
+    e.price = discount * mean_y;
+    e.stderr_value = discount * std::sqrt(var_y / n);
+    e.plain_stderr = e.stderr_value;
+    if (estimator.antithetic) {
+        double var_path = std::max(m.single_yy.value() / n - mean_y * mean_y, 0.0) * n / (n - 1);
+        e.plain_stderr = discount * std::sqrt(var_path / (2.0 * n));
+    }
+    e.beta = 0.0;
+    if (estimator.control_variate) {
+        double mean_x = m.x.value() / n;
+        double var_x = (m.xx.value() / n - mean_x * mean_x) * n / (n - 1);
+        double cov = (m.xy.value() / n - mean_x * mean_y) * n / (n - 1);
+        e.beta = var_x > 0.0 ? cov / var_x : 0.0;
+        e.price = discount * (mean_y - e.beta * mean_x);
+        // One degree of freedom goes to beta
+        double var_cv = std::max(var_y - e.beta * cov, 0.0) * (n - 1) / (n - 2);
+        e.stderr_value = discount * std::sqrt(var_cv / n);
+    }
+    return e;
+}
+
+// Stratified: sums[2j], sums[2j+1] = sums of Y and Y^2 over the N_j = runs
+// n_j paths of stratum j, all the strata of probability 1/M
+inline Estimate estimate_stratified(const CompensatedSum* sums, const Strata& strata, double runs, double discount,
+                                    double payoff_variance) {
+    Estimate e = {};
+    double mean = 0.0, variance = 0.0, total = 0.0;
+    const double p = 1.0 / strata.count;
+    for (int j = 0; j < strata.count; ++j) {
+        double n = runs * strata.paths(j);
+        total += n;
+        // No path: the stratum is out of the money, its mean is exactly 0
+        if (n == 0.0) continue;
+        double mean_j = sums[2 * j].value() / n;
+        double var_j = n > 1.0 ? std::max(sums[2 * j + 1].value() / n - mean_j * mean_j, 0.0) * n / (n - 1) : 0.0;
+        mean += p * mean_j;
+        variance += p * p * var_j / n;
+    }
+    e.price = discount * mean;
+    e.stderr_value = discount * std::sqrt(variance);
+    e.plain_stderr = discount * std::sqrt(payoff_variance / total);
+    return e;
+}
+
+// Independent replicates (the runs of a Latin hypercube): mean of the
+// replicate means and their standard error
+inline Estimate estimate_replicates(const std::vector<CompensatedSum>& sums, double paths, double discount,
+                                    double payoff_variance) {
+    Estimate e = {};
+    double R = (double)sums.size();
+    CompensatedSum sum, sum2;
+    for (const CompensatedSum& s : sums) {
+        double mean = s.value() / paths;
+        sum.add(mean);
+        sum2.add(mean * mean);
+    }
+    double mean = sum.value() / R;
+    double var = R > 1.0 ? std::max(sum2.value() / R - mean * mean, 0.0) * R / (R - 1) : 0.0;
+    e.price = discount * mean;
+    e.stderr_value = discount * std::sqrt(var / R);
+    e.plain_stderr = discount * std::sqrt(payoff_variance / (R * paths));
+    return e;
+}
@@ -0,0 +1,144 @@
+/*
+    Inverse of the normal CDF, Z = Phi^-1(u), as a pure function of one
+    uniform: no rejection, so a block of uniforms (pseudo or quasi random,
+    stratified, ...) maps lane by lane to a block of normals.
+
+    Two accuracy modes:
+      Fast    : double: Acklam's rational approximation, relative error < 1.15e-9
+                float : Wichura's AS241 PPND7, relative error < 5e-7 (Acklam
+                        cancels badly in float near its region boundary)
+      Refined : Wichura's AS241 PPND16, relative error ~1e-16
+
+    Every region of the approximation is evaluated and the right one is
+    selected afterwards, so the loops have no branch and vectorize fully.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "simd_math.h"
+
+enum class IcdfAccuracy { Fast, Refined };
+
+namespace inverse_normal {
+
+// Acklam, central region |u - 0.5| <= 0.5 - P_LOW, tails otherwise
+SIMD_INLINE double acklam(double u) {
+    const double a1 = -3.969683028665376e+01, a2 = 2.209460984245205e+02, a3 = -2.759285104469687e+02;
+    const double a4 = 1.383577518672690e+02, a5 = -3.066479806614716e+01, a6 = 2.506628277459239e+00;
+    const double b1 = -5.447609879822406e+01, b2 = 1.615858368580409e+02, b3 = -1.556989798598866e+02;
+    const double b4 = 6.680131188771972e+01, b5 = -1.328068155288572e+01;
+    const double c1 = -7.784894002430293e-03, c2 = -3.223964580411365e-01, c3 = -2.400758277161838e+00;
+    const double c4 = -2.549732539343734e+00, c5 = 4.374664141464968e+00, c6 = 2.938163982698783e+00;
+    const double d1 = 7.784695709041462e-03, d2 = 3.224671290700398e-01, d3 = 2.445134137142996e+00;
+    const double d4 = 3.754408661907416e+00;
+    const double P_LOW = 0.02425;
+
+    double q = u - 0.5;
+    double r = q * q;
+    double central = (((((a1 * r + a2) * r + a3) * r + a4) * r + a5) * r + a6) * q
+                   / (((((b1 * r + b2) * r + b3) * r + b4) * r + b5) * r + 1.0);
+    double t = std::min(u, 1.0 - u);
+    double s = std::sqrt(-2.0 * simd_math::log(t));
+    double tail = (((((c1 * s + c2) * s + c3) * s + c4) * s + c5) * s + c6)
+                / ((((d1 * s + d2) * s + d3) * s + d4) * s + 1.0);
+    tail = q < 0.0 ? tail : -tail;
+    return t < P_LOW ? tail : central;
+}
+
+// Wichura AS241, three regions: |q| <= 0.425, r <= 5, r > 5
+SIMD_INLINE double as241(double u) {
+    const double a0 = 3.3871328727963666080e0, a1 = 1.3314166789178437745e+2;
+    const double a2 = 1.9715909503065514427e+3, a3 = 1.3731693765509461125e+4;
+    const double a4 = 4.5921953931549871457e+4, a5 = 6.7265770927008700853e+4;
+    const double a6 = 3.3430575583588128105e+4, a7 = 2.5090809287301226727e+3;
+    const double b1 = 4.2313330701600911252e+1, b2 = 6.8718700749205790830e+2;
+    const double b3 = 5.3941960214247511077e+3, b4 = 2.1213794301586595867e+4;
+    const double b5 = 3.9307895800092710610e+4, b6 = 2.8729085735721942674e+4;
+    const double b7 = 5.2264952788528545610e+3;
+    const double c0 = 1.42343711074968357734e0, c1 = 4.63033784615654529590e0;
+    const double c2 = 5.76949722146069140550e0, c3 = 3.64784832476320460504e0;
+    const double c4 = 1.27045825245236838258e0, c5 = 2.41780725177450611770e-1;
+    const double c6 = 2.27238449892691845833e-2, c7 = 7.74545014278341407640e-4;
+    const double d1 = 2.05319162663775882187e0, d2 = 1.67638483018380384940e0;
+    const double d3 = 6.89767334985100004550e-1, d4 = 1.48103976427480074590e-1;
+    const double d5 = 1.51986665636164571966e-2, d6 = 5.47593808499534494600e-4;
+    const double d7 = 1.05075007164441684324e-9;
+    const double e0 = 6.65790464350110377720e0, e1 = 5.46378491116411436990e0;
+    const double e2 = 1.78482653991729133580e0, e3 = 2.96560571828504891230e-1;
+    const double e4 = 2.65321895265761230930e-2, e5 = 1.24266094738807843860e-3;
+    const double e6 = 2.71155556874348757815e-5, e7 = 2.01033439929228813265e-7;
+    const double f1 = 5.99832206555887937690e-1, f2 = 1.36929880922735805310e-1;
+    const double f3 = 1.48753612908506148525e-2, f4 = 7.86869131145613259100e-4;
+    const double f5 = 1.84631831751005468180e-5, f6 = 1.42151175831644588870e-7;
+    const double f7 = 2.04426310338993978564e-15;
+
+    double q = u - 0.5;
+    double r = 0.180625 - q * q;
+    double central = q * (((((((a7 * r + a6) * r + a5) * r + a4) * r + a3) * r + a2) * r + a1) * r + a0)
+                       / (((((((b7 * r + b6) * r + b5) * r + b4) * r + b3) * r + b2) * r + b1) * r + 1.0);
+    double t = std::min(u, 1.0 - u);
+    double s = std::sqrt(-simd_math::log(t));
+    double s1 = s - 1.6;
+    double mid = (((((((c7 * s1 + c6) * s1 + c5) * s1 + c4) * s1 + c3) * s1 + c2) * s1 + c1) * s1 + c0)
+               / (((((((d7 * s1 + d6) * s1 + d5) * s1 + d4) * s1 + d3) * s1 + d2) * s1 + d1) * s1 + 1.0);
+    double s5 = s - 5.0;
+    double far = (((((((e7 * s5 + e6) * s5 + e5) * s5 + e4) * s5 + e3) * s5 + e2) * s5 + e1) * s5 + e0)
+               / (((((((f7 * s5 + f6) * s5 + f5) * s5 + f4) * s5 + f3) * s5 + f2) * s5 + f1) * s5 + 1.0);
+    double tail = s <= 5.0 ? mid : far;
+    tail = q < 0.0 ? -tail : tail;
+    return std::fabs(q) <= 0.425 ? central : tail;
+}
+
+// Wichura AS241 PPND7, single precision version with the same three regions
+SIMD_INLINE float ppnd7(float u) {
+    const float a0 = 3.3871327179E+00f, a1 = 5.0434271938E+01f, a2 = 1.5929113202E+02f, a3 = 5.9109374720E+01f;
+    const float b1 = 1.7895169469E+01f, b2 = 7.8757757664E+01f, b3 = 6.7187563600E+01f;
+    const float c0 = 1.4234372777E+00f, c1 = 2.7568153900E+00f, c2 = 1.3067284816E+00f, c3 = 1.7023821103E-01f;
+    const float d1 = 7.3700164250E-01f, d2 = 1.2021132975E-01f;
+    const float e0 = 6.6579051150E+00f, e1 = 3.0812263860E+00f, e2 = 4.2868294337E-01f, e3 = 1.7337203997E-02f;
+    const float f1 = 2.4197894225E-01f, f2 = 1.2258202635E-02f;
+
+    float q = u - 0.5f;
+    float r = 0.180625f - q * q;
+    float central = q * (((a3 * r + a2) * r + a1) * r + a0) / (((b3 * r + b2) * r + b1) * r + 1.0f);
+    float t = std::min(u, 1.0f - u);
+    float s = std::sqrt(-simd_math::log(t));
+    float s1 = s - 1.6f;
+    float mid = (((c3 * s1 + c2) * s1 + c1) * s1 + c0) / ((d2 * s1 + d1) * s1 + 1.0f);
+    float s5 = s - 5.0f;
+    float far = (((e3 * s5 + e2) * s5 + e1) * s5 + e0) / ((f2 * s5 + f1) * s5 + 1.0f);
+    float tail = s <= 5.0f ? mid : far;
+    tail = q < 0.0f ? -tail : tail;
+    return std::fabs(q) <= 0.425f ? central : tail;
+}
+
+// z[i] = Phi^-1(u[i]) for u in (0,1), in place allowed
+inline void transform(const double* u, double* z, size_t n, IcdfAccuracy accuracy) {
+    if (accuracy == IcdfAccuracy::Refined) {
+        #pragma omp simd
+        for (size_t i = 0; i < n; ++i)
+            z[i] = as241(u[i]);
+    } else {
+        #pragma omp simd
+        for (size_t i = 0; i < n; ++i)
+            z[i] = acklam(u[i]);
+    }
+}
+
+// Float lanes, the refined mode goes through AS241 in double
+inline void transform(const float* u, float* z, size_t n, IcdfAccuracy accuracy) {
+    if (accuracy == IcdfAccuracy::Refined) {
+        #pragma omp simd
+        for (size_t i = 0; i < n; ++i)
+            z[i] = (float)as241((double)u[i]);
+    } else {
+        #pragma omp simd
+        for (size_t i = 0; i < n; ++i)
+            z[i] = ppnd7(u[i]);
+    }
+}
+
+} // namespace inverse_normal
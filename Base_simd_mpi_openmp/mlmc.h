@@ -0,0 +1,206 @@
+/*
+    Multilevel Monte Carlo (--mlmc <epsilon>), Giles (2008).
+
+    Time-stepped pricing: level l simulates S with 2^l Milstein steps of
+    h = T / 2^l on the GBM dS = (r - q) S dt + sigma S dW,
+
+        S += S ((r - q) h + sigma dW + sigma^2 / 2 (dW^2 - h))
+
+    and the price is the telescoping sum
+
+        E[P_L] = E[P_0] + sum_{l=1..L} E[P_l - P_{l-1}]
+
+    Each correction Y_l = P_l - P_{l-1} is sampled on coupled pairs: the
+    coarse path takes the sums of two consecutive fine increments, so Y_l
+    has a small variance V_l ~ 2^(-beta l) and few samples are needed on
+    the expensive levels. After every pass the samples per level are
+
+        N_l = sqrt(V_l / C_l) sum_k sqrt(V_k C_k) / ((1 - theta) epsilon^2)
+
+    (C_l the steps of a pair: 1 at level 0, 1.5 2^l above), which puts a
+    share 1 - theta of the mean square error epsilon^2 on the variance.
+    Levels are added while the remaining bias, extrapolated from the last
+    corrections with the weak order alpha, is above sqrt(theta) epsilon.
+    alpha and beta are fitted on the levels so far (at least 0.5).
+
+    The cost for an RMS error epsilon drops from O(epsilon^-3) for plain
+    Monte Carlo at the finest level (epsilon^-2 paths of epsilon^-1 steps)
+    to O(epsilon^-2) when beta > 1 (Milstein on the call: beta ~ 1.5).
+
+    The European call is the payoff here, the closed form checks the
+    result; a path-dependent payoff only changes the kernel. The samples
+    are tiles of paths aligned on the path index of their level, and the
+    cost model is the number of steps and not a timing: the sums, so the
+    number of levels and of samples, do not depend on the ranks x threads
+    layout.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "reduce.h"
+
+namespace mlmc {
+
+struct Problem {
+    double S0, K, T;
+    double rate;        // r - q
+    double sigma;
+    double discount;    // exp(-r T)
+};
+
+// Discounted sums of one level
+struct LevelSums {
+    CompensatedSum y, yy;           // Y_l = P_l - P_{l-1}
+    CompensatedSum fine, fine2;     // P_l alone, for the cost of plain Monte Carlo
+
+    // Number of reduce::mpi_type() pairs sent to MPI
+    static constexpr int PAIRS = 4;
+
+    void merge(const LevelSums& other) {
+        y.merge(other.y);
+        yy.merge(other.yy);
+        fine.merge(other.fine);
+        fine2.merge(other.fine2);
+    }
+};
+static_assert(sizeof(LevelSums) == LevelSums::PAIRS * sizeof(CompensatedSum), "LevelSums must be contiguous pairs");
+
+struct Config {
+    double epsilon;             // target root mean square error
+    uint64_t pilot;             // first samples of a level, a multiple of unit
+    uint64_t unit;              // samples are drawn by whole tiles
+    int min_levels = 3;         // levels 0..2 from the start
+    int max_levels = 16;
+    double theta = 0.25;        // share of the squared error left to the bias
+};
+
+struct Result {
+    double price = 0.0;
+    double stderr_value = 0.0;
+    double alpha = 0.0, beta = 0.0;
+    double cost = 0.0;          // steps of all the samples
+    double plain_cost = 0.0;    // plain Monte Carlo at the finest level for the same error
+    bool converged = true;      // false when max_levels did not bring the bias down
+    std::vector<uint64_t> samples;
+    std::vector<double> mean, variance;
+};
+
+// Steps of one sample of level l
+inline double cost(int l) { return l == 0 ? 1.0 : 1.5 * std::ldexp(1.0, l); }
+
+// -slope of the least squares line through (l, log2 values[l]), l = 1..L
+inline double decay(const std::vector<double>& values) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t l = 1; l < values.size(); ++l) {
+        double y = std::log2(std::max(values[l], 1e-300));
+        n += 1;
+        sx += l;
+        sy += y;
+        sxx += (double)l * l;
+        sxy += l * y;
+    }
+    if (n < 2) return 0.5;
+    return std::max(0.5, -(n * sxy - sx * sy) / (n * sxx - sx * sx));
+}
+
+// sample(first, count, sums): count[l] more samples of every level l from
+// sample first[l] on, their sums over all the ranks in sums[l] (the same on
+// every rank, so every rank takes the same decisions)
+using Sampler = std::function<void(const std::vector<uint64_t>&, const std::vector<uint64_t>&,
+                                   std::vector<LevelSums>&)>;
+
+inline Result estimate(const Config& config, const Sampler& sample, bool verbose) {
+    Result r;
+    int L = config.min_levels;
+    std::vector<LevelSums> totals(L), pass;
+    std::vector<uint64_t> N(L, 0), dN(L, config.pilot);
+    std::vector<double> mean(L), variance(L), fine_variance(L);
+    auto round_up = [&](double n) {
+        return (uint64_t)std::ceil(n / config.unit) * config.unit;
+    };
+    // Giles' allocation of the samples on the levels 0..L-1
+    auto allocate = [&]() {
+        double sum = 0.0;
+        for (int l = 0; l < L; ++l) sum += std::sqrt(variance[l] * cost(l));
+        for (int l = 0; l < L; ++l) {
+            double n = std::sqrt(variance[l] / cost(l)) * sum / ((1.0 - config.theta) * config.epsilon * config.epsilon);
+            // At least a tile, every level needs an estimate of its variance
+            uint64_t wanted = std::max(round_up(n), config.unit);
+            dN[l] = wanted > N[l] ? wanted - N[l] : 0;
+        }
+    };
+    for (;;) {
+        pass.assign(L, LevelSums());
+        sample(N, dN, pass);
+        for (int l = 0; l < L; ++l) {
+            totals[l].merge(pass[l]);
+            N[l] += dN[l];
+        }
+        for (int l = 0; l < L; ++l) {
+            double n = (double)N[l];
+            mean[l] = totals[l].y.value() / n;
+            variance[l] = std::max(totals[l].yy.value() / n - mean[l] * mean[l], 0.0) * n / (n - 1);
+            double f = totals[l].fine.value() / n;
+            fine_variance[l] = std::max(totals[l].fine2.value() / n - f * f, 0.0) * n / (n - 1);
+        }
+        std::vector<double> abs_mean(L);
+        for (int l = 0; l < L; ++l) abs_mean[l] = std::fabs(mean[l]);
+        // Very few of the coarse-fine pairs may differ on the deep levels:
+        // not less than half the value extrapolated from the coarser level
+        r.alpha = decay(abs_mean);
+        r.beta = decay(variance);
+        for (int l = 2; l < L; ++l) {
+            abs_mean[l] = std::max(abs_mean[l], 0.5 * abs_mean[l - 1] / std::exp2(r.alpha));
+            variance[l] = std::max(variance[l], 0.5 * variance[l - 1] / std::exp2(r.beta));
+        }
+        allocate();
+        bool settled = true;
+        for (int l = 0; l < L; ++l) settled = settled && dN[l] <= 0.01 * N[l];
+        if (!settled) continue;
+        // Remaining bias from the last three corrections
+        double remaining = 0.0;
+        for (int i = 0; i < 3 && i < L - 1; ++i)
+            remaining = std::max(remaining, abs_mean[L - 1 - i] / std::exp2(i * r.alpha));
+        remaining /= std::exp2(r.alpha) - 1.0;
+        if (remaining <= std::sqrt(config.theta) * config.epsilon) break;
+        if (L == config.max_levels) {
+            r.converged = false;
+            break;
+        }
+        if (verbose)
+            std::cout << "  mlmc level " << L << " added, remaining bias " << std::scientific << std::setprecision(2)
+                      << remaining << std::defaultfloat << std::endl;
+        ++L;
+        totals.resize(L);
+        N.push_back(0);
+        dN.push_back(0);
+        mean.push_back(0.0);
+        fine_variance.push_back(0.0);
+        variance.push_back(variance[L - 2] / std::exp2(r.beta));
+        allocate();
+    }
+    double total_variance = 0.0;
+    for (int l = 0; l < L; ++l) {
+        r.price += mean[l];
+        total_variance += variance[l] / N[l];
+        r.cost += N[l] * cost(l);
+    }
+    r.stderr_value = std::sqrt(total_variance);
+    // Same error with plain Monte Carlo on the finest level: V[P_L] /
+    // ((1 - theta) epsilon^2) paths of 2^(L-1) steps
+    r.plain_cost = fine_variance[L - 1] / ((1.0 - config.theta) * config.epsilon * config.epsilon)
+                 * std::ldexp(1.0, L - 1);
+    r.samples = N;
+    r.mean = mean;
+    r.variance = variance;
+    return r;
+}
+
+} // namespace mlmc
@@ -0,0 +1,185 @@
+/*
+    Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+    numbers: as easy as 1, 2, 3", SC'11).
+
+    A stream is a pure function (key, counter) -> 4 x 32 random bits, so there
+    is no engine state to seed per thread and any position can be reached in
+    O(1) by setting the counter.
+
+    Layout used by PhiloxEngine (rng.h):
+        key     = seed::derive(global_seed, 0, 0, seed::PATHS) (2 x 32 bits)
+        counter = { block index (64 bits), run (32 bits), 0 (32 bits) }
+
+    The stream of a run is the same on every rank and thread: the paths of
+    a run are split between the ranks in whole tiles, and each rank seeks
+    (GaussianStream::seek_draw) to the block of its first path and reads its
+    own slice. A path therefore gets the same draws whatever the number of
+    ranks, of threads, and whichever thread prices the run. The last word of
+    the counter (PhiloxStream's rank) is kept at 0 by PhiloxEngine.
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace philox {
+
+constexpr uint32_t M0 = 0xD2511F53u;
+constexpr uint32_t M1 = 0xCD9E8D57u;
+constexpr uint32_t W0 = 0x9E3779B9u;
+constexpr uint32_t W1 = 0xBB67AE85u;
+
+// Number of counters processed together, 8 x 32 bits fills a 256 bits register
+constexpr int LANES = 8;
+
+inline void round(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1) {
+    uint64_t p0 = (uint64_t)M0 * c0;
+    uint64_t p1 = (uint64_t)M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n1 = (uint32_t)p1;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    uint32_t n3 = (uint32_t)p0;
+    c0 = n0; c1 = n1; c2 = n2; c3 = n3;
+}
+
+// Philox4x32 with 10 rounds on a single counter
+inline void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; ++r) {
+        round(c0, c1, c2, c3, k0, k1);
+        k0 += W0; k1 += W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// Same thing on LANES consecutive block indexes, written as structure of
+// arrays so that the compiler maps every lane loop to vector instructions
+// (umull/umull2 on NEON, vpmuludq on AVX2)
+inline void philox4x32_10_lanes(uint64_t first_block, uint32_t run, uint32_t rank, const uint32_t key[2],
+                                uint32_t out0[LANES], uint32_t out1[LANES], uint32_t out2[LANES], uint32_t out3[LANES]) {
+    #pragma omp simd
+    for (int l = 0; l < LANES; ++l) {
+        uint64_t block = first_block + l;
+        uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = run, c3 = rank;
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int r = 0; r < 10; ++r) {
+            round(c0, c1, c2, c3, k0, k1);
+            k0 += W0; k1 += W1;
+        }
+        out0[l] = c0; out1[l] = c1; out2[l] = c2; out3[l] = c3;
+    }
+}
+
+// 53 random bits -> double in the open interval (0,1), never 0 so log() is safe
+inline double to_unit_double(uint32_t hi, uint32_t lo) {
+    uint64_t bits = (((uint64_t)hi << 32) | lo) >> 11;
+    return ((double)(int64_t)bits + 0.5) * 0x1.0p-53;
+}
+
+// 24 random bits -> float in the open interval (0,1)
+inline float to_unit_float(uint32_t x) {
+    return ((float)(int32_t)(x >> 8) + 0.5f) * 0x1.0p-24f;
+}
+
+} // namespace philox
+
+// One independent stream of uniforms, identified by (seed, rank, run);
+// PhiloxEngine always passes rank 0
+class PhiloxStream {
+public:
+    PhiloxStream(uint64_t seed, uint32_t rank, uint64_t run)
+        : run_((uint32_t)run), rank_(rank), block_(0) {
+        key_[0] = (uint32_t)seed;
+        key_[1] = (uint32_t)(seed >> 32);
+    }
+
+    // Switch to the stream of another run, from its first block
+    void set_run(uint64_t run) { run_ = (uint32_t)run; block_ = 0; }
+
+    // Jump to any position of the stream in O(1), one block = 128 bits
+    void seek(uint64_t block) { block_ = block; }
+    uint64_t tell() const { return block_; }
+
+    // Fill out[0..n) with raw 64 bits words. Consumes ceil(n/2) blocks.
+    void bits(uint64_t* out, size_t n) {
+        alignas(64) uint32_t x0[philox::LANES], x1[philox::LANES], x2[philox::LANES], x3[philox::LANES];
+        size_t i = 0;
+        while (i < n) {
+            philox::philox4x32_10_lanes(block_, run_, rank_, key_, x0, x1, x2, x3);
+            if (i + 2 * philox::LANES <= n) {
+                #pragma omp simd
+                for (int l = 0; l < philox::LANES; ++l) {
+                    out[i + 2 * l]     = ((uint64_t)x0[l] << 32) | x1[l];
+                    out[i + 2 * l + 1] = ((uint64_t)x2[l] << 32) | x3[l];
+                }
+                i += 2 * philox::LANES;
+                block_ += philox::LANES;
+            } else {
+                for (int l = 0; i < n; ++l) {
+                    out[i++] = ((uint64_t)x0[l] << 32) | x1[l];
+                    if (i < n) out[i++] = ((uint64_t)x2[l] << 32) | x3[l];
+                    ++block_;
+                }
+            }
+        }
+    }
+
+    // Fill out[0..n) with uniforms in (0,1). Consumes ceil(n/2) blocks.
+    void uniforms(double* out, size_t n) {
+        alignas(64) uint32_t x0[philox::LANES], x1[philox::LANES], x2[philox::LANES], x3[philox::LANES];
+        size_t i = 0;
+        while (i < n) {
+            philox::philox4x32_10_lanes(block_, run_, rank_, key_, x0, x1, x2, x3);
+            if (i + 2 * philox::LANES <= n) {
+                #pragma omp simd
+                for (int l = 0; l < philox::LANES; ++l) {
+                    out[i + 2 * l]     = philox::to_unit_double(x0[l], x1[l]);
+                    out[i + 2 * l + 1] = philox::to_unit_double(x2[l], x3[l]);
+                }
+                i += 2 * philox::LANES;
+                block_ += philox::LANES;
+            } else {
+                // Tail: only consume the blocks actually used
+                for (int l = 0; i < n; ++l) {
+                    out[i++] = philox::to_unit_double(x0[l], x1[l]);
+                    if (i < n) out[i++] = philox::to_unit_double(x2[l], x3[l]);
+                    ++block_;
+                }
+            }
+        }
+    }
+
+    // Fill out[0..n) with uniforms in (0,1). Consumes ceil(n/4) blocks.
+    void uniforms(float* out, size_t n) {
+        alignas(64) uint32_t x0[philox::LANES], x1[philox::LANES], x2[philox::LANES], x3[philox::LANES];
+        size_t i = 0;
+        while (i < n) {
+            philox::philox4x32_10_lanes(block_, run_, rank_, key_, x0, x1, x2, x3);
+            if (i + 4 * philox::LANES <= n) {
+                #pragma omp simd
+                for (int l = 0; l < philox::LANES; ++l) {
+                    out[i + 4 * l]     = philox::to_unit_float(x0[l]);
+                    out[i + 4 * l + 1] = philox::to_unit_float(x1[l]);
+                    out[i + 4 * l + 2] = philox::to_unit_float(x2[l]);
+                    out[i + 4 * l + 3] = philox::to_unit_float(x3[l]);
+                }
+                i += 4 * philox::LANES;
+                block_ += philox::LANES;
+            } else {
+                for (int l = 0; i < n; ++l) {
+                    const uint32_t x[4] = {x0[l], x1[l], x2[l], x3[l]};
+                    for (int k = 0; k < 4 && i < n; ++k)
+                        out[i++] = philox::to_unit_float(x[k]);
+                    ++block_;
+                }
+            }
+        }
+    }
+
+private:
+    uint32_t key_[2];
+    uint32_t run_;
+    uint32_t rank_;
+    uint64_t block_;
+};
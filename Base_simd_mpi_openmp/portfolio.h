@@ -0,0 +1,207 @@
+/*
+    Portfolio input (--portfolio <file.bin|file.csv>): millions of European
+    contracts without parsing them at every run nor holding them in RAM.
+
+    Binary format, native byte order, one header then fixed size records:
+
+        header  "BSMPORT1" | uint64 count | uint32 version | uint32 record size
+        record  uint32 type (0 call, 1 put) | uint32 reserved |
+                double S0, K, T, r, q, sigma                      (56 bytes)
+
+    The file is mapped read-only (mmap) and walked in chunks of contracts:
+    a chunk is read straight from the mapping, priced, then its pages are
+    released (MADV_DONTNEED), so the resident memory is a few chunks
+    whatever the size of the portfolio.
+
+    CSV import: one contract per line, "type,S0,K,T,r,q,sigma" with type
+    call or put, '#' comments and a header line starting with "type"
+    skipped. import_csv streams it line by line into <name>.bin.tmp, renamed
+    to the binary only once the whole CSV is converted, so a failed import
+    leaves no binary behind; it does not replace an existing binary unless
+    told to (--overwrite on).
+
+    Both the CSV lines and the binary records are checked (portfolio::valid)
+    and a bad contract rejects the whole file: type 0 or 1, S0 > 0, K > 0,
+    T >= 0, sigma >= 0 and all of them finite. The records of a binary are
+    checked once (MappedPortfolio::check on rank 0), not by every rank.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct PortfolioHeader {
+    char magic[8];
+    uint64_t count;
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct PortfolioRecord {
+    uint32_t type;          // 0 call, 1 put
+    uint32_t reserved;
+    double S0, K, T, r, q, sigma;
+};
+static_assert(sizeof(PortfolioHeader) == 24, "portfolio header layout");
+static_assert(sizeof(PortfolioRecord) == 56, "portfolio record layout");
+
+namespace portfolio {
+
+constexpr char MAGIC[8] = {'B', 'S', 'M', 'P', 'O', 'R', 'T', '1'};
+constexpr uint32_t VERSION = 1;
+
+inline bool valid(const PortfolioRecord& c) {
+    return c.type <= 1 && c.S0 > 0.0 && c.K > 0.0 && c.T >= 0.0 && c.sigma >= 0.0 && std::isfinite(c.S0)
+           && std::isfinite(c.K) && std::isfinite(c.T) && std::isfinite(c.r) && std::isfinite(c.q)
+           && std::isfinite(c.sigma);
+}
+
+// CSV to binary, false with a message naming the line on a malformed one
+inline bool import_csv(const std::string& csv_path, const std::string& bin_path, bool overwrite, std::string& error) {
+    std::ifstream in(csv_path);
+    if (!in) {
+        error = "cannot read " + csv_path;
+        return false;
+    }
+    struct stat st;
+    if (!overwrite && stat(bin_path.c_str(), &st) == 0) {
+        error = bin_path + " exists, pass it instead of the CSV or add --overwrite on";
+        return false;
+    }
+    const std::string tmp = bin_path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    PortfolioHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.record_size = sizeof(PortfolioRecord);
+    // The count is written once known
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::string line;
+    for (uint64_t number = 1; std::getline(in, line); ++number) {
+        if (line.empty() || line[0] == '#' || line.compare(0, 4, "type") == 0) continue;
+        for (char& c : line)
+            if (c == ',') c = ' ';
+        std::istringstream fields(line);
+        std::string type;
+        PortfolioRecord record = {};
+        bool parsed = (bool)(fields >> type >> record.S0 >> record.K >> record.T >> record.r >> record.q
+                                    >> record.sigma);
+        record.type = type == "call" ? 0 : type == "put" ? 1 : 2;
+        if (!parsed || !valid(record)) {
+            error = csv_path + ":" + std::to_string(number) + ": expected type,S0,K,T,r,q,sigma";
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        ++header.count;
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out || std::rename(tmp.c_str(), bin_path.c_str()) != 0) {
+        error = "cannot write " + bin_path;
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace portfolio
+
+// Read-only mapping of a binary portfolio
+class MappedPortfolio {
+public:
+    MappedPortfolio() = default;
+    ~MappedPortfolio() { close(); }
+    MappedPortfolio(const MappedPortfolio&) = delete;
+    MappedPortfolio& operator=(const MappedPortfolio&) = delete;
+
+    // false with a message if the file cannot be mapped or is not a portfolio
+    bool open(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) ::close(fd);
+            error = "cannot open " + path;
+            return false;
+        }
+        bytes_ = (size_t)st.st_size;
+        void* base = bytes_ >= sizeof(PortfolioHeader) ? mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0)
+                                                       : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+        base_ = static_cast<const char*>(base);
+        const PortfolioHeader* header = reinterpret_cast<const PortfolioHeader*>(base_);
+        if (std::memcmp(header->magic, portfolio::MAGIC, sizeof(portfolio::MAGIC)) != 0
+            || header->version != portfolio::VERSION || header->record_size != sizeof(PortfolioRecord)
+            || header->count > (bytes_ - sizeof(PortfolioHeader)) / sizeof(PortfolioRecord)) {
+            error = path + " is not a portfolio (or is truncated)";
+            close();
+            return false;
+        }
+        count_ = header->count;
+        path_ = path;
+        madvise(const_cast<char*>(base_), bytes_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    // false with a message naming the first invalid contract. One pass over
+    // the records, by chunks released as it goes.
+    bool check(std::string& error) const {
+        const uint64_t CHECK = 1 << 16;
+        for (uint64_t first = 0; first < count_; first += CHECK) {
+            uint64_t n = std::min(CHECK, count_ - first);
+            for (uint64_t i = first; i < first + n; ++i)
+                if (!portfolio::valid(records()[i])) {
+                    error = path_ + ": contract " + std::to_string(i) + " is invalid (type, S0, K, T or sigma)";
+                    return false;
+                }
+            release(first, n);
+        }
+        return true;
+    }
+
+    uint64_t size() const { return count_; }
+    const PortfolioRecord* records() const {
+        return reinterpret_cast<const PortfolioRecord*>(base_ + sizeof(PortfolioHeader));
+    }
+
+    // Drops the pages holding only records [first, first + n), they are read
+    // again from the file if ever touched
+    void release(uint64_t first, uint64_t n) const {
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = sizeof(PortfolioHeader) + first * sizeof(PortfolioRecord);
+        size_t end = begin + n * sizeof(PortfolioRecord);
+        begin = (begin + page - 1) / page * page;
+        end = end / page * page;
+        if (begin < end) madvise(const_cast<char*>(base_) + begin, end - begin, MADV_DONTNEED);
+    }
+
+    void close() {
+        if (base_) munmap(const_cast<char*>(base_), bytes_);
+        base_ = nullptr;
+        bytes_ = 0;
+        count_ = 0;
+    }
+
+private:
+    const char* base_ = nullptr;
+    std::string path_;
+    size_t bytes_ = 0;
+    uint64_t count_ = 0;
+};
@@ -0,0 +1,80 @@
+/*
+    Reproducible sums of the payoffs.
+
+    The payoffs are summed in fixed-size blocks (one kernel tile, aligned on
+    the global path index, always summed in the same lane order), and the
+    block sums go into a Neumaier compensated pair (sum, c) that carries
+    about twice the precision of a double. Threads, runs and MPI ranks merge
+    these pairs. The merge is not associative (c is a plain double), but
+    two groupings differ by about 2^-100 relative, so the final sum + c
+    rounded to a double is reproducible to that level whatever the number
+    of threads or ranks, as long as the blocks hold the same values. It is
+    the same double in practice: only a sum within ~2^-100 of a rounding
+    boundary can round the other way.
+
+    On the MPI side the pair is a contiguous datatype of 2 doubles with its
+    own reduction operator (reduce::mpi_type(), reduce::mpi_sum()), created
+    once after MPI_Init and released by reduce::mpi_free().
+*/
+#pragma once
+
+#include <cmath>
+#include <mpi.h>
+
+struct CompensatedSum {
+    double sum = 0.0;
+    double c = 0.0;     // running compensation, the low order bits lost by sum
+
+    // Neumaier: the error of each addition is recovered whichever of the two
+    // operands is larger
+    void add(double x) {
+        double t = sum + x;
+        if (std::fabs(sum) >= std::fabs(x))
+            c += (sum - t) + x;
+        else
+            c += (x - t) + sum;
+        sum = t;
+    }
+    void merge(const CompensatedSum& other) {
+        add(other.sum);
+        c += other.c;
+    }
+    double value() const { return sum + c; }
+};
+
+namespace reduce {
+
+inline void mpi_sum_op(void* in, void* inout, int* len, MPI_Datatype*) {
+    const CompensatedSum* a = static_cast<const CompensatedSum*>(in);
+    CompensatedSum* b = static_cast<CompensatedSum*>(inout);
+    for (int i = 0; i < *len; ++i) {
+        // inout = in + inout, in comes from the lower ranks
+        CompensatedSum r = a[i];
+        r.merge(b[i]);
+        b[i] = r;
+    }
+}
+
+inline MPI_Datatype& mpi_type() {
+    static MPI_Datatype type = MPI_DATATYPE_NULL;
+    if (type == MPI_DATATYPE_NULL) {
+        MPI_Type_contiguous(2, MPI_DOUBLE, &type);
+        MPI_Type_commit(&type);
+    }
+    return type;
+}
+
+// Declared non commutative: MPI then combines the ranks in rank order
+inline MPI_Op& mpi_sum() {
+    static MPI_Op op = MPI_OP_NULL;
+    if (op == MPI_OP_NULL)
+        MPI_Op_create(&mpi_sum_op, 0, &op);
+    return op;
+}
+
+inline void mpi_free() {
+    MPI_Type_free(&mpi_type());
+    MPI_Op_free(&mpi_sum());
+}
+
+} // namespace reduce
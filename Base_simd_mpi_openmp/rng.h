@@ -0,0 +1,262 @@
+/*
+    Uniform random engines behind one interface, the Gaussian generators and
+    the pricing kernel are templated on it:
+
+        Engine(uint64_t global_seed, uint32_t rank, uint32_t thread)
+        void start_run(uint64_t run)          position the engine for one run
+        void seek(uint64_t block)             jump inside the run, 128 bits blocks
+                                              (counter based only, else no-op)
+        void bits(uint64_t* out, size_t n)    raw 64 bits words
+        void uniforms(double* out, size_t n)  in the open interval (0,1)
+        void uniforms(float* out, size_t n)   in the open interval (0,1)
+        static constexpr const char* name
+
+    One engine lives per (rank, thread).
+
+      philox     counter based, run in the counter: start_run and seek are
+                 O(1) jumps. All the ranks share the stream of a run and
+                 each one seeks to its own slice, so the paths do not depend
+                 on the number of threads nor of ranks (default)
+      xoshiro    xoshiro256++ (Blackman & Vigna), one seeded state; each rank
+                 takes a long_jump() (2^192 draws) and each thread a jump()
+                 (2^128 draws) inside it, so the streams never overlap
+      mt19937    std::mt19937, same generator as boost::random::mt19937 used
+                 by Base_boost_simd, seeded with seed::derive(.., thread, ..)
+      sfmt       SFMT19937 (Saito & Matsumoto), 128 bits SIMD friendly
+                 recursion of the Mersenne Twister
+
+    With the state based engines (xoshiro, mt19937, sfmt) a thread draws its
+    runs one after the other from its own stream: the result is reproducible
+    for a given seed and a given ranks x threads layout only.
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <random>
+
+#include "philox.h"
+#include "seed.h"
+
+namespace rng {
+
+// 53 bits -> (0,1) and 24 bits -> (0,1), never 0 so log() is safe
+inline double unit_double(uint64_t x) { return ((double)(int64_t)(x >> 11) + 0.5) * 0x1.0p-53; }
+inline float unit_float(uint32_t x) { return ((float)(int32_t)(x >> 8) + 0.5f) * 0x1.0p-24f; }
+
+// Uniforms from any engine exposing bits(), the conversion is vectorized
+template <class Engine>
+inline void uniforms_from_bits(Engine& e, double* out, size_t n) {
+    alignas(64) uint64_t w[256];
+    for (size_t base = 0; base < n; base += 256) {
+        size_t m = n - base < 256 ? n - base : 256;
+        e.bits(w, m);
+        #pragma omp simd
+        for (size_t i = 0; i < m; ++i)
+            out[base + i] = unit_double(w[i]);
+    }
+}
+
+template <class Engine>
+inline void uniforms_from_bits(Engine& e, float* out, size_t n) {
+    alignas(64) uint64_t w[128];
+    for (size_t base = 0; base < n; base += 256) {
+        size_t m = n - base < 256 ? n - base : 256;
+        e.bits(w, (m + 1) / 2);
+        #pragma omp simd
+        for (size_t i = 0; i < m; ++i)
+            out[base + i] = unit_float((uint32_t)(w[i / 2] >> (32 * (i & 1))));
+    }
+}
+
+} // namespace rng
+
+class PhiloxEngine {
+public:
+    static constexpr const char* name = "philox";
+    PhiloxEngine(uint64_t global_seed, uint32_t /*rank*/, uint32_t /*thread*/)
+        : stream_(seed::derive(global_seed, 0, 0, seed::PATHS), 0, 0) {}
+    void start_run(uint64_t run) { stream_.set_run(run); }
+    void seek(uint64_t block) { stream_.seek(block); }
+    void bits(uint64_t* out, size_t n) { stream_.bits(out, n); }
+    void uniforms(double* out, size_t n) { stream_.uniforms(out, n); }
+    void uniforms(float* out, size_t n) { stream_.uniforms(out, n); }
+private:
+    PhiloxStream stream_;
+};
+
+class Xoshiro256pp {
+public:
+    static constexpr const char* name = "xoshiro";
+    Xoshiro256pp(uint64_t global_seed, uint32_t rank, uint32_t thread) {
+        // Same base state everywhere, then disjoint sub-streams
+        uint64_t sm = seed::derive(global_seed, 0, 0, seed::PATHS);
+        for (int i = 0; i < 4; ++i)
+            s_[i] = seed::mix(sm + i * 0x9E3779B97F4A7C15ull);
+        for (uint32_t r = 0; r < rank; ++r) long_jump();
+        for (uint32_t t = 0; t < thread; ++t) jump();
+    }
+    void start_run(uint64_t) {}
+    void seek(uint64_t) {}
+
+    uint64_t next() {
+        const uint64_t result = rotl(s_[0] + s_[3], 23) + s_[0];
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // Equivalent to 2^128 calls to next()
+    void jump() {
+        static const uint64_t JUMP[4] = {0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+                                         0xa9582618e03fc9aaull, 0x39abdc4529b1661cull};
+        apply(JUMP);
+    }
+    // Equivalent to 2^192 calls to next()
+    void long_jump() {
+        static const uint64_t LONG_JUMP[4] = {0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull,
+                                              0x77710069854ee241ull, 0x39109bb02acbe635ull};
+        apply(LONG_JUMP);
+    }
+
+    void bits(uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) out[i] = next();
+    }
+    void uniforms(double* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+    void uniforms(float* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    void apply(const uint64_t poly[4]) {
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (int i = 0; i < 4; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (poly[i] & ((uint64_t)1 << b)) {
+                    s0 ^= s_[0]; s1 ^= s_[1]; s2 ^= s_[2]; s3 ^= s_[3];
+                }
+                next();
+            }
+        s_[0] = s0; s_[1] = s1; s_[2] = s2; s_[3] = s3;
+    }
+    uint64_t s_[4];
+};
+
+class Mt19937Engine {
+public:
+    static constexpr const char* name = "mt19937";
+    Mt19937Engine(uint64_t global_seed, uint32_t rank, uint32_t thread) {
+        uint64_t s = seed::derive(global_seed, rank, thread, seed::PATHS);
+        std::seed_seq seq{(uint32_t)s, (uint32_t)(s >> 32)};
+        gen_.seed(seq);
+    }
+    void start_run(uint64_t) {}
+    void seek(uint64_t) {}
+    void bits(uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t hi = gen_();
+            out[i] = (hi << 32) | gen_();
+        }
+    }
+    void uniforms(double* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+    void uniforms(float* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+private:
+    std::mt19937 gen_;
+};
+
+// SFMT19937: 156 words of 128 bits regenerated at once, the recursion works
+// on 4 x 32 bits lanes (a NEON / SSE register)
+class SfmtEngine {
+public:
+    static constexpr const char* name = "sfmt";
+    static constexpr int N = 156;
+    static constexpr int N32 = N * 4;
+
+    SfmtEngine(uint64_t global_seed, uint32_t rank, uint32_t thread) {
+        uint64_t s = seed::derive(global_seed, rank, thread, seed::PATHS);
+        init_gen_rand((uint32_t)(s ^ (s >> 32)));
+    }
+    void start_run(uint64_t) {}
+    void seek(uint64_t) {}
+
+    void init_gen_rand(uint32_t s) {
+        uint32_t* p = &state_[0][0];
+        p[0] = s;
+        for (int i = 1; i < N32; ++i)
+            p[i] = 1812433253u * (p[i - 1] ^ (p[i - 1] >> 30)) + i;
+        period_certification();
+        idx_ = N32;
+    }
+
+    uint32_t next32() {
+        if (idx_ >= N32) { gen_rand_all(); idx_ = 0; }
+        return (&state_[0][0])[idx_++];
+    }
+
+    void bits(uint64_t* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t lo = next32();
+            out[i] = ((uint64_t)next32() << 32) | lo;
+        }
+    }
+    void uniforms(double* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+    void uniforms(float* out, size_t n) { rng::uniforms_from_bits(*this, out, n); }
+
+private:
+    static constexpr int POS1 = 122, SL1 = 18, SL2 = 1, SR1 = 11, SR2 = 1;
+    static constexpr uint32_t MSK[4] = {0xdfffffefu, 0xddfecb7fu, 0xbffaffffu, 0xbffffff6u};
+    static constexpr uint32_t PARITY[4] = {0x00000001u, 0x00000000u, 0x00000000u, 0x13c9e684u};
+
+    // 128 bits shifts by bytes, lanes in little endian order
+    static void lshift128(uint32_t out[4], const uint32_t in[4], int shift) {
+        uint64_t th = ((uint64_t)in[3] << 32) | in[2], tl = ((uint64_t)in[1] << 32) | in[0];
+        uint64_t oh = (th << (shift * 8)) | (tl >> (64 - shift * 8)), ol = tl << (shift * 8);
+        out[0] = (uint32_t)ol; out[1] = (uint32_t)(ol >> 32); out[2] = (uint32_t)oh; out[3] = (uint32_t)(oh >> 32);
+    }
+    static void rshift128(uint32_t out[4], const uint32_t in[4], int shift) {
+        uint64_t th = ((uint64_t)in[3] << 32) | in[2], tl = ((uint64_t)in[1] << 32) | in[0];
+        uint64_t oh = th >> (shift * 8), ol = (tl >> (shift * 8)) | (th << (64 - shift * 8));
+        out[0] = (uint32_t)ol; out[1] = (uint32_t)(ol >> 32); out[2] = (uint32_t)oh; out[3] = (uint32_t)(oh >> 32);
+    }
+    static void do_recursion(uint32_t r[4], const uint32_t a[4], const uint32_t b[4],
+                             const uint32_t c[4], const uint32_t d[4]) {
+        uint32_t x[4], y[4];
+        lshift128(x, a, SL2);
+        rshift128(y, c, SR2);
+        for (int k = 0; k < 4; ++k)
+            r[k] = a[k] ^ x[k] ^ ((b[k] >> SR1) & MSK[k]) ^ y[k] ^ (d[k] << SL1);
+    }
+    void gen_rand_all() {
+        const uint32_t* r1 = state_[N - 2];
+        const uint32_t* r2 = state_[N - 1];
+        int i = 0;
+        for (; i < N - POS1; ++i) {
+            do_recursion(state_[i], state_[i], state_[i + POS1], r1, r2);
+            r1 = r2; r2 = state_[i];
+        }
+        for (; i < N; ++i) {
+            do_recursion(state_[i], state_[i], state_[i + POS1 - N], r1, r2);
+            r1 = r2; r2 = state_[i];
+        }
+    }
+    void period_certification() {
+        uint32_t inner = 0;
+        for (int i = 0; i < 4; ++i)
+            inner ^= state_[0][i] & PARITY[i];
+        for (int i = 16; i > 0; i >>= 1)
+            inner ^= inner >> i;
+        if (inner & 1) return;
+        for (int i = 0; i < 4; ++i) {
+            uint32_t work = 1;
+            for (int j = 0; j < 32; ++j, work <<= 1)
+                if (work & PARITY[i]) { state_[0][i] ^= work; return; }
+        }
+    }
+
+    alignas(16) uint32_t state_[N][4];
+    int idx_;
+};
@@ -0,0 +1,37 @@
+/*
+    Per-thread working memory of the pricing kernel.
+
+    The kernel generates, prices and reduces one tile of draws at a time, so
+    the only buffer it needs is one tile of normals: allocated once per
+    thread before the runs, 64 bytes aligned, never resized. Memory is
+    O(threads x tile) whatever the number of simulations, and a tile sized
+    for L1 (the default 512 doubles = 4 KB) never goes back to DRAM between
+    the generation and the payoff.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+class TileScratch {
+public:
+    explicit TileScratch(size_t tile) : tile_(tile) {
+        size_t bytes = (tile * sizeof(double) + 63) / 64 * 64;
+        data_ = static_cast<double*>(std::aligned_alloc(64, bytes));
+        if (!data_) throw std::bad_alloc();
+    }
+    ~TileScratch() { std::free(data_); }
+    TileScratch(const TileScratch&) = delete;
+    TileScratch& operator=(const TileScratch&) = delete;
+
+    // Number of draws per tile
+    size_t tile() const { return tile_; }
+    double* z() { return data_; }
+    // Same memory for the float kernels, a tile of floats fits in it
+    float* z_float() { return reinterpret_cast<float*>(data_); }
+
+private:
+    size_t tile_;
+    double* data_;
+};
@@ -0,0 +1,51 @@
+/*
+    Seed hierarchy: every generator of a job is derived from one global seed
+
+        seed::derive(global, rank, task, stream)
+
+    global : --seed on the command line, else one std::random_device draw on
+             rank 0 broadcast to the other ranks
+    rank   : MPI rank (or replicate group)
+    task   : logical unit of work, i.e. the run index. Never the OpenMP thread
+             number, so the result does not depend on the scheduling nor on
+             OMP_NUM_THREADS.
+    stream : what the bits are used for (paths, QMC scrambling, ...)
+
+    Equal inputs give bitwise identical results. Counter-based generators
+    (Philox) put the run in their counter, every rank seeks to its own slice
+    of it, and only take their key from here. The state based engines of
+    rng.h (mt19937, sfmt) cannot jump to a run, they are seeded per
+    (rank, thread) with task = thread number, which ties their result to the
+    ranks x threads layout.
+*/
+#pragma once
+
+#include <cstdint>
+
+namespace seed {
+
+enum Stream : uint64_t {
+    PATHS = 0,          // random numbers of the paths
+    QMC_SCRAMBLE = 1,   // randomization of the Sobol point set
+};
+
+// splitmix64 finalizer, a bijection with full avalanche
+inline uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t combine(uint64_t h, uint64_t value) {
+    return mix(h ^ (value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2)));
+}
+
+inline uint64_t derive(uint64_t global, uint64_t rank, uint64_t task, uint64_t stream) {
+    uint64_t h = mix(global);
+    h = combine(h, stream);
+    h = combine(h, rank);
+    return combine(h, task);
+}
+
+} // namespace seed
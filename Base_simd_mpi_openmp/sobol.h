@@ -0,0 +1,181 @@
+/*
+    Sobol low-discrepancy sequence, 32 bits, base 2.
+
+    The direction numbers come from Joe & Kuo (new-joe-kuo-6.21201) and are
+    stored in the compact (degree s, coefficients a, initial m_i) form; the
+    32 x MAX_DIMS direction integers are expanded once by sobol::directions()
+    (2 KB, fits in L1).
+
+    Points are generated in Gray-code order: point n+1 is point n XOR one
+    direction integer, the one indexed by the lowest zero bit of n. Jumping to
+    any index costs 32 XOR, so every MPI rank / OpenMP thread can start
+    directly at its own contiguous block of the sequence.
+
+    Randomization of the whole point set (same for all the blocks):
+      None         : plain Sobol
+      DigitalShift : x ^ shift_d, one random 32 bits shift per dimension
+      Owen         : nested uniform scrambling, hash based (Burley 2020,
+                     "Practical Hash-based Owen Scrambling")
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+enum class Scramble { None, DigitalShift, Owen };
+
+namespace sobol {
+
+constexpr int MAX_DIMS = 16;
+constexpr int BITS = 32;
+// Number of points available before the sequence wraps
+constexpr uint64_t MAX_POINTS = (uint64_t)1 << BITS;
+
+// Joe & Kuo: dimension d+2 uses a primitive polynomial of degree s with
+// inner coefficients a, and initial direction numbers m[0..s)
+struct Primitive { int s; uint32_t a; uint32_t m[6]; };
+constexpr Primitive PRIMITIVES[MAX_DIMS - 1] = {
+    {1,  0, {1}},
+    {2,  1, {1, 3}},
+    {3,  1, {1, 3, 1}},
+    {3,  2, {1, 1, 1}},
+    {4,  1, {1, 1, 3, 3}},
+    {4,  4, {1, 3, 5, 13}},
+    {5,  2, {1, 1, 5, 5, 17}},
+    {5,  4, {1, 1, 5, 5, 5}},
+    {5,  7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6,  1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+};
+
+struct Directions {
+    uint32_t v[MAX_DIMS][BITS];
+
+    Directions() {
+        // First dimension: van der Corput, v_k = 2^(31-k)
+        for (int k = 0; k < BITS; ++k)
+            v[0][k] = 1u << (BITS - 1 - k);
+        for (int d = 1; d < MAX_DIMS; ++d) {
+            const Primitive& p = PRIMITIVES[d - 1];
+            for (int k = 0; k < p.s; ++k)
+                v[d][k] = p.m[k] << (BITS - 1 - k);
+            for (int k = p.s; k < BITS; ++k) {
+                uint32_t x = v[d][k - p.s] ^ (v[d][k - p.s] >> p.s);
+                for (int j = 1; j < p.s; ++j)
+                    if ((p.a >> (p.s - 1 - j)) & 1)
+                        x ^= v[d][k - j];
+                v[d][k] = x;
+            }
+        }
+    }
+};
+
+inline const Directions& directions() {
+    static const Directions t;
+    return t;
+}
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Nested uniform (Owen) scrambling of a base 2 fraction: each bit is flipped
+// depending on a hash of the bits above it
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+inline uint32_t hash32(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return (uint32_t)x;
+}
+
+} // namespace sobol
+
+// One coordinate (dimension) of a randomized Sobol point set
+class SobolStream {
+public:
+    // scramble_seed comes from the seed hierarchy, one per replicate
+    SobolStream(int dim, Scramble scramble, uint64_t scramble_seed)
+        : v_(sobol::directions().v[dim]), scramble_(scramble),
+          key_(sobol::hash32(scramble_seed * 0x9E3779B97F4A7C15ull + (uint64_t)dim)) {
+        seek(0);
+    }
+
+    // Jump to point `index` in O(BITS): x = XOR of v_k over the bits of gray(index)
+    void seek(uint64_t index) {
+        index_ = index;
+        uint64_t gray = index ^ (index >> 1);
+        x_ = 0;
+        for (int k = 0; k < sobol::BITS; ++k)
+            if ((gray >> k) & 1)
+                x_ ^= v_[k];
+    }
+    uint64_t tell() const { return index_; }
+
+    // Fill out[0..n) with the next n points of this coordinate, in (0,1)
+    template <typename Real>
+    void uniforms(Real* out, size_t n) {
+        alignas(64) uint32_t x[CHUNK];
+        for (size_t base = 0; base < n; base += CHUNK) {
+            size_t m = n - base < CHUNK ? n - base : CHUNK;
+            // Gray-code recurrence, one XOR per point. The last point of the
+            // sequence (index 2^BITS - 1) has no successor: ctz(~index) would
+            // be BITS, past the direction numbers
+            for (size_t i = 0; i < m; ++i) {
+                x[i] = x_;
+                if (index_ + 1 < sobol::MAX_POINTS) x_ ^= v_[__builtin_ctzll(~index_)];
+                ++index_;
+            }
+            // Randomization and conversion, vectorized over the block
+            if (scramble_ == Scramble::Owen) {
+                #pragma omp simd
+                for (size_t i = 0; i < m; ++i)
+                    x[i] = sobol::owen_scramble(x[i], key_);
+            } else if (scramble_ == Scramble::DigitalShift) {
+                #pragma omp simd
+                for (size_t i = 0; i < m; ++i)
+                    x[i] ^= key_;
+            }
+            // Midpoint of the cell, never 0 nor 1. In float the cell index
+            // keeps 23 bits so that index + 0.5 is exact: with 24 the last
+            // cell rounds to 1.0 and the inverse CDF blows up
+            if (std::is_same<Real, float>::value) {
+                #pragma omp simd
+                for (size_t i = 0; i < m; ++i)
+                    out[base + i] = ((float)(int32_t)(x[i] >> 9) + 0.5f) * 0x1.0p-23f;
+            } else {
+                #pragma omp simd
+                for (size_t i = 0; i < m; ++i)
+                    out[base + i] = ((double)x[i] + 0.5) * 0x1.0p-32;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t CHUNK = 256;
+    const uint32_t* v_;
+    Scramble scramble_;
+    uint32_t key_;
+    uint64_t index_;
+    uint32_t x_;
+};
@@ -0,0 +1,131 @@
+/*
+    Stratified and Latin hypercube sampling of the terminal normal
+    (--stratify <M>, --allocation, --lhs).
+
+    Stratified: (0,1) is cut in M strata of probability 1/M, stratum j
+    takes n_j paths of every run with u = (j + U) / M, U uniform, and Z =
+    Phi^-1(u) by the inverse CDF. The strata are contiguous ranges of the
+    path index of the run, [first[j], first[j+1]), so any split of the run
+    between ranks and tiles gives every path the same stratum and the same
+    uniform (the engines seek by path index, as without strata). Each
+    stratum has its own compensated sums of Y and Y^2, the price is
+
+        sum_j (1/M) mean_j        variance  sum_j (1/M)^2 s_j^2 / N_j
+
+    Allocation:
+      proportional : n_j = N / M
+      neyman       : n_j proportional to the standard deviation of the
+                     payoff in the stratum, computed in closed form for the
+                     call (no pilot run). The strata entirely below the
+                     log-strike threshold z* pay exactly 0 and get no path,
+                     the others at least 2.
+
+    Latin hypercube: one stratum per path of the run, u_k = (k + U_k) / N.
+    This is the one-dimensional case (the terminal normal of a European
+    payoff), where the order of the strata does not change any estimate,
+    so no permutation of the strata is drawn. The runs are the independent
+    replicates that give the standard error.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "inverse_normal.h"
+#include "pricing.h"
+#include "simd_math.h"
+
+enum class Allocation { Proportional, Neyman };
+
+struct Strata {
+    int count = 0;                      // M, 0 when not stratified
+    std::vector<uint64_t> first;        // M + 1 path indices, first[M] = paths per run
+
+    // Stratum of path k of the run
+    int of(uint64_t k) const {
+        return (int)(std::upper_bound(first.begin(), first.end(), k) - first.begin()) - 1;
+    }
+    uint64_t paths(int j) const { return first[j + 1] - first[j]; }
+};
+
+namespace stratify {
+
+// Standard deviation of Y = max(A e^(vZ) - K, 0) given Z in (a, b), from
+// E[e^(cZ); l < Z < b] = e^(c^2/2) (Phi(b - c) - Phi(l - c))
+inline double call_stddev(const PricingPlan& plan, double a, double b, double probability) {
+    double v = plan.diffusion, A = plan.S0 * std::exp(plan.drift), K = plan.K;
+    double l = std::max(a, plan.z_star);
+    if (!(l < b)) return 0.0;
+    auto mass = [&](double c) { return simd_math::norm_cdf(b - c) - simd_math::norm_cdf(l - c); };
+    double m1 = A * std::exp(0.5 * v * v) * mass(v);
+    double m0 = mass(0.0);
+    double mean = (m1 - K * m0) / probability;
+    double second = (A * A * std::exp(2.0 * v * v) * mass(2.0 * v) - 2.0 * K * m1 + K * K * m0) / probability;
+    return std::sqrt(std::max(second - mean * mean, 0.0));
+}
+
+// Strata of paths_per_run paths, needs paths_per_run >= 2 M
+inline Strata make(int M, uint64_t paths_per_run, Allocation allocation, const PricingPlan& plan) {
+    assert(M >= 1 && paths_per_run >= 2 * (uint64_t)M);
+    Strata strata;
+    strata.count = M;
+    std::vector<double> weight(M, 1.0);
+    std::vector<bool> active(M, true);
+    if (allocation == Allocation::Neyman) {
+        for (int j = 0; j < M; ++j) {
+            double a = j == 0 ? -INFINITY : inverse_normal::as241((double)j / M);
+            double b = j == M - 1 ? INFINITY : inverse_normal::as241((double)(j + 1) / M);
+            // Entirely out of the money: its mean is exactly 0
+            active[j] = b > plan.z_star;
+            weight[j] = active[j] ? call_stddev(plan, a, b, 1.0 / M) : 0.0;
+        }
+    }
+    double total = 0.0;
+    int n_active = 0;
+    for (int j = 0; j < M; ++j) {
+        total += weight[j];
+        n_active += active[j];
+    }
+    // No stratum reaches z* (e.g. z* = +inf): every path pays 0, any
+    // allocation gives the price 0, proportional keeps the paths spread
+    if (n_active == 0) {
+        weight.assign(M, 1.0);
+        active.assign(M, true);
+        total = M;
+        n_active = M;
+    }
+    // At least 2 paths per active stratum, the rest by weight, largest
+    // remainders first so that the counts add up to paths_per_run
+    std::vector<uint64_t> n(M, 0);
+    std::vector<std::pair<double, int>> remainder;
+    uint64_t spare = paths_per_run - 2 * (uint64_t)n_active, given = 0;
+    for (int j = 0; j < M; ++j) {
+        if (!active[j]) continue;
+        double share = total > 0.0 ? spare * weight[j] / total : (double)spare / n_active;
+        n[j] = 2 + (uint64_t)share;
+        given += n[j] - 2;
+        remainder.push_back({share - std::floor(share), j});
+    }
+    std::sort(remainder.begin(), remainder.end(), [](const std::pair<double, int>& x, const std::pair<double, int>& y) {
+        return x.first > y.first || (x.first == y.first && x.second < y.second);
+    });
+    for (size_t i = 0; given < spare; i = (i + 1) % remainder.size(), ++given)
+        ++n[remainder[i].second];
+    strata.first.assign(M + 1, 0);
+    for (int j = 0; j < M; ++j)
+        strata.first[j + 1] = strata.first[j] + n[j];
+    return strata;
+}
+
+} // namespace stratify
+
+namespace lhs {
+
+// Uniform of point k of an n point Latin hypercube in one dimension, from
+// the uniform U in [0,1) of the point
+inline double uniform(uint64_t k, uint64_t n, double U) { return ((double)k + U) / (double)n; }
+
+} // namespace lhs
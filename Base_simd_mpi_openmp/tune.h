@@ -0,0 +1,231 @@
+/*
+    Startup autotuner (--autotune auto|sweep).
+
+    The fastest kernel configuration depends on the core and the compiler
+    (see log_c7g_arm.txt, log_c7g_gcc.txt, log_armclag.txt), so instead of
+    re-running the matrix by hand the program can measure it:
+
+      sweep : short calibration runs of the real pricing loop, one
+              dimension at a time keeping the best so far (greedy). Every
+              rank runs every candidate at the same time and the slowest
+              rank's time is the score, so contention between ranks is part
+              of the measurement.
+      auto  : load the winner from the cache, sweep only when the cache
+              has no entry for this machine.
+
+    What the sweep may change (--autotune-scope):
+
+      layout : (default) the tile and the threads per rank only, the
+               options that do not change the price for a given --seed.
+               The engine, Gaussian method and precision stay the user's.
+               The tile is left alone with --moment-match (the blocks are
+               matched one tile at a time) and in mixed or float precision
+               (the float partial sums are flushed once per tile); the
+               threads are left alone for the state based engines
+               (xoshiro, mt19937, sfmt), whose streams follow the ranks x
+               threads layout.
+      all    : also the uniform engine x Gaussian method and the precision
+               (double or mixed). Opt-in: the tuned run prices other draws
+               than the same --seed untuned, and a state based engine ties
+               the result to the layout.
+
+    The cache is a text file (default $HOME/.bsm_tune, --autotune-cache) with
+    one line per key, the key being CPU model, number of cores, number of
+    ranks, QMC or not, compiler version and the scope (for layout, with the
+    fixed engine, method and precision):
+
+        <key> \t <engine> <method> <precision> <tile> <threads>
+
+    Precision::Float is never a candidate: its float accumulation is biased
+    on long runs.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gaussian.h"
+#include "pricing.h"
+
+// Everything the tuner chooses
+struct TuneConfig {
+    std::string engine = "philox";
+    GaussMethod method = GaussMethod::BoxMuller;
+    Precision precision = Precision::Double;
+    uint64_t tile = 512;
+    int threads = 1;
+};
+
+// What the sweep may change, see the scopes above
+struct TuneScope {
+    bool results = false;       // engine, method and precision (scope all)
+    bool tile = true;
+    bool threads = true;
+};
+
+namespace tune {
+
+static const char* const ENGINES[] = {"philox", "xoshiro", "mt19937", "sfmt"};
+static const GaussMethod METHODS[] = {GaussMethod::BoxMuller, GaussMethod::Ziggurat, GaussMethod::InverseCDF};
+static const char* const METHOD_NAMES[] = {"boxmuller", "ziggurat", "icdf"};
+static const Precision PRECISIONS[] = {Precision::Double, Precision::Mixed};
+static const char* const PRECISION_NAMES[] = {"double", "float", "mixed"};
+static const uint64_t TILES[] = {256, 512, 1024, 2048, 4096};
+
+inline const char* method_name(GaussMethod m) { return METHOD_NAMES[(int)m]; }
+inline const char* precision_name(Precision p) { return PRECISION_NAMES[(int)p]; }
+
+// "model name" on x86, implementer/part on Arm (e.g. 0x41/0xd40 = Neoverse V1)
+inline std::string cpu_model() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line, implementer, part;
+    while (std::getline(in, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string field = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        std::string value = line.substr(std::min(line.size(), colon + 2));
+        if (field == "model name") return value;
+        if (field == "CPU implementer" && implementer.empty()) implementer = value;
+        if (field == "CPU part" && part.empty()) part = value;
+    }
+    if (!part.empty()) return "arm " + implementer + "/" + part;
+    return "unknown cpu";
+}
+
+inline std::string key(int ranks, bool qmc, const std::string& scope) {
+    std::ostringstream k;
+    k << cpu_model() << " | " << std::thread::hardware_concurrency() << " cores | " << ranks << " ranks | "
+      << (qmc ? "qmc" : "mc") << " | " << __VERSION__ << " | " << scope;
+    return k.str();
+}
+
+inline std::string default_path() {
+    const char* home = std::getenv("HOME");
+    return home ? std::string(home) + "/.bsm_tune" : std::string(".bsm_tune");
+}
+
+inline std::string to_string(const TuneConfig& c) {
+    std::ostringstream s;
+    s << c.engine << " " << method_name(c.method) << " " << precision_name(c.precision) << " "
+      << c.tile << " " << c.threads;
+    return s.str();
+}
+
+inline bool from_string(const std::string& text, TuneConfig& c) {
+    std::istringstream s(text);
+    std::string method, precision;
+    TuneConfig r;
+    if (!(s >> r.engine >> method >> precision >> r.tile >> r.threads)) return false;
+    int m = 0, p = 0;
+    while (m < 3 && method != METHOD_NAMES[m]) ++m;
+    while (p < 3 && precision != PRECISION_NAMES[p]) ++p;
+    if (m == 3 || p == 3 || r.tile < 8 || r.tile % 8 != 0 || r.threads < 1) return false;
+    r.method = (GaussMethod)m;
+    r.precision = (Precision)p;
+    c = r;
+    return true;
+}
+
+// Entry of this key, false when there is none (or the file does not exist)
+inline bool load(const std::string& path, const std::string& k, TuneConfig& c) {
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos && line.compare(0, tab, k) == 0)
+            return from_string(line.substr(tab + 1), c);
+    }
+    return false;
+}
+
+// Replaces the entry of this key, the other machines' entries are kept.
+// Written to a temporary file then renamed, a concurrent reader never sees
+// half a file.
+inline bool save(const std::string& path, const std::string& k, const TuneConfig& c) {
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line))
+            if (line.compare(0, line.find('\t'), k) != 0) lines.push_back(line);
+    }
+    lines.push_back(k + "\t" + to_string(c));
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const std::string& line : lines) out << line << "\n";
+        if (!out) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Greedy search from start over what scope allows. seconds(c) runs the
+// calibration of c and returns its time; it must give the same value on
+// every rank (the caller reduces it) so that all the ranks walk the same
+// candidates.
+inline TuneConfig sweep(TuneConfig start, const TuneScope& scope, bool qmc, int max_threads,
+                        const std::function<double(const TuneConfig&)>& seconds, bool verbose) {
+    if (scope.results && start.precision == Precision::Float) start.precision = Precision::Mixed;
+    TuneConfig best = start;
+    double best_time = std::numeric_limits<double>::infinity();
+    auto consider = [&](const TuneConfig& c) {
+        double t = seconds(c);
+        if (verbose)
+            std::cout << "  tune " << to_string(c) << std::fixed << std::setprecision(4) << "  " << t << " s" << std::endl;
+        if (t < best_time) {
+            best_time = t;
+            best = c;
+        }
+    };
+    consider(start);
+    if (scope.results) {
+        // Engine and method do not matter in QMC mode, the points come from Sobol
+        if (!qmc) {
+            TuneConfig base = best;
+            for (const char* engine : ENGINES)
+                for (GaussMethod method : METHODS) {
+                    TuneConfig c = base;
+                    c.engine = engine;
+                    c.method = method;
+                    if (c.engine != start.engine || c.method != start.method) consider(c);
+                }
+        }
+        TuneConfig base = best;
+        for (Precision precision : PRECISIONS) {
+            TuneConfig c = base;
+            c.precision = precision;
+            if (precision != base.precision) consider(c);
+        }
+    }
+    if (scope.tile) {
+        TuneConfig base = best;
+        for (uint64_t tile : TILES) {
+            TuneConfig c = base;
+            c.tile = tile;
+            if (tile != base.tile) consider(c);
+        }
+    }
+    // Fewer threads per rank only pays when the ranks oversubscribe the cores
+    if (scope.threads) {
+        TuneConfig base = best;
+        for (int threads = max_threads / 2; threads >= 1; threads /= 2) {
+            TuneConfig c = base;
+            c.threads = threads;
+            consider(c);
+        }
+    }
+    return best;
+}
+
+} // namespace tune
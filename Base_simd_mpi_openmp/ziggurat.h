@@ -0,0 +1,153 @@
+/*
+    Ziggurat normal sampler (Marsaglia & Tsang 2000, layout of Doornik's
+    ZIGNOR) with 256 layers.
+
+    One 64 bits word per normal: the low 8 bits select the layer i, the high
+    52 bits give u in [-1,1). When |u| < x[i+1]/x[i] (about 99% of the draws)
+    the result is simply u*x[i]: this fast path is a table lookup, a compare
+    and a multiply, done for a whole block in a vectorized loop.
+    The rejected draws (base strip tail and wedges) are compacted into an
+    index list and finished in a scalar side loop.
+
+    Tables: 257 + 256 doubles = 4 KB, built once by ziggurat::tables().
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace ziggurat {
+
+constexpr int LAYERS = 256;
+constexpr double R = 3.6541528853610088;       // start of the tail
+constexpr double V = 4.92867323399e-3;         // area of each layer
+// Draws processed per pass of the fast path
+constexpr size_t CHUNK = 512;
+
+struct Tables {
+    double x[LAYERS + 1];   // right edge of each layer, x[0] is the virtual base width
+    double ratio[LAYERS];   // x[i+1]/x[i], acceptance bound of the fast path
+
+    Tables() {
+        double f = std::exp(-0.5 * R * R);
+        x[0] = V / f;
+        x[1] = R;
+        x[LAYERS] = 0.0;
+        for (int i = 2; i < LAYERS; ++i) {
+            x[i] = std::sqrt(-2.0 * std::log(V / x[i - 1] + f));
+            f = std::exp(-0.5 * x[i] * x[i]);
+        }
+        for (int i = 0; i < LAYERS; ++i)
+            ratio[i] = x[i + 1] / x[i];
+    }
+};
+
+inline const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+// 52 high bits -> [-1,1) without int->double conversion
+inline double signed_unit(uint64_t w) {
+    uint64_t b = (w >> 12) | 0x3ff0000000000000ull;
+    double d;
+    std::memcpy(&d, &b, 8);
+    return 2.0 * (d - 1.0) - 1.0;
+}
+
+// Small buffer of fresh uniforms for the scalar side loop
+template <class Engine>
+class SlowUniforms {
+public:
+    explicit SlowUniforms(Engine& s) : stream_(s), pos_(SIZE) {}
+    double next() {
+        if (pos_ == SIZE) { stream_.uniforms(buf_, SIZE); pos_ = 0; }
+        return buf_[pos_++];
+    }
+    uint64_t next_bits() {
+        uint64_t w;
+        stream_.bits(&w, 1);
+        return w;
+    }
+private:
+    static constexpr int SIZE = 16;
+    Engine& stream_;
+    double buf_[SIZE];
+    int pos_;
+};
+
+// Complete a draw rejected by the fast path (tail, wedge, or retry)
+template <class Engine>
+inline double slow_path(uint64_t w, SlowUniforms<Engine>& rng) {
+    const Tables& t = tables();
+    for (;;) {
+        double u = signed_unit(w);
+        int i = (int)(w & (LAYERS - 1));
+        if (std::fabs(u) < t.ratio[i])
+            return u * t.x[i];
+        if (i == 0) {
+            // Tail beyond R (Marsaglia 1964)
+            double x, y;
+            do {
+                x = std::log(rng.next()) / R;
+                y = std::log(rng.next());
+            } while (-2.0 * y < x * x);
+            return u < 0 ? x - R : R - x;
+        }
+        // Wedge between two layers
+        double x = u * t.x[i];
+        double f0 = std::exp(-0.5 * (t.x[i] * t.x[i] - x * x));
+        double f1 = std::exp(-0.5 * (t.x[i + 1] * t.x[i + 1] - x * x));
+        if (f1 + rng.next() * (f0 - f1) < 1.0)
+            return x;
+        w = rng.next_bits();
+    }
+}
+
+// Fill out[0..n) with N(0,1) values, any engine of rng.h
+template <class Engine>
+inline void fill(Engine& stream, double* out, size_t n) {
+    const Tables& t = tables();
+    alignas(64) uint64_t w[CHUNK];
+    alignas(64) uint8_t reject[CHUNK];
+    uint32_t idx[CHUNK];
+    SlowUniforms<Engine> rng(stream);
+    for (size_t base = 0; base < n; base += CHUNK) {
+        size_t m = std::min(CHUNK, n - base);
+        double* o = out + base;
+        stream.bits(w, m);
+        // Fast path on the whole block
+        #pragma omp simd
+        for (size_t k = 0; k < m; ++k) {
+            double u = signed_unit(w[k]);
+            uint64_t i = w[k] & (LAYERS - 1);
+            o[k] = u * t.x[i];
+            reject[k] = std::fabs(u) >= t.ratio[i];
+        }
+        // Compaction of the rare rejected draws
+        size_t nrej = 0;
+        for (size_t k = 0; k < m; ++k) {
+            idx[nrej] = (uint32_t)k;
+            nrej += reject[k];
+        }
+        for (size_t j = 0; j < nrej; ++j)
+            o[idx[j]] = slow_path(w[idx[j]], rng);
+    }
+}
+
+template <class Engine>
+inline void fill(Engine& stream, float* out, size_t n) {
+    alignas(64) double buf[CHUNK];
+    for (size_t base = 0; base < n; base += CHUNK) {
+        size_t m = std::min(CHUNK, n - base);
+        fill(stream, buf, m);
+        #pragma omp simd
+        for (size_t k = 0; k < m; ++k)
+            out[base + k] = (float)buf[k];
+    }
+}
+
+} // namespace ziggurat
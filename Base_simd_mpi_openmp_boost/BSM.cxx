@@ -45,6 +45,7 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
 #include <arm_acle.h>
 #include <cblas.h>
 #include <arm_neon.h>
+#include "../Base_simd_mpi_openmp/simd_math.h"
 #define ui64 u_int64_t
 
 #include <sys/time.h>
@@ -91,8 +92,7 @@ double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sig
         // Stock price at maturity
         float64x2_t diffusion = vmulq_f64(sub_diffusion, Z);
         float64x2_t exponent = vaddq_f64(drift, diffusion);
-        float64x2_t ST = vmulq_f64(S0_vec,
-		       	float64x2_t{exp(vgetq_lane_f64(exponent, 0)), exp(vgetq_lane_f64(exponent, 1))});
+        float64x2_t ST = vmulq_f64(S0_vec, simd_math::exp_f64x2(exponent));
         // Payoff calculation
         float64x2_t payoff = vmaxq_f64(vsubq_f64(ST, K_vec), zero);
         // Sum up payoffs
@@ -41,6 +41,7 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
 #include <arm_acle.h>
 #include <cblas.h>
 #include <arm_neon.h>
+#include "../Base_simd_mpi_openmp/simd_math.h"
 #define ui64 u_int64_t
 
 #include <sys/time.h>
@@ -81,7 +82,8 @@ double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sig
     );
     float64x2_t sub_diffusion = vmulq_f64(sigma_vec, vdupq_n_f64(sqrt(T)));
     float64x2_t zero =  vdupq_n_f64(0.0);
-    for (ui64 i = 0; i < num_simulations; i += 4) {
+    ui64 i = 0;
+    for (; i + 4 <= num_simulations; i += 4) {
         // Generate random numbers (4 per iteration)
         float64x2_t Z1 = {gaussian_box_muller(), gaussian_box_muller()};
 	float64x2_t Z2 = {gaussian_box_muller(), gaussian_box_muller()};
@@ -90,15 +92,18 @@ double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sig
         float64x2_t diffusion2 = vmulq_f64(sub_diffusion, Z2);
         float64x2_t exponent1 = vaddq_f64(drift, diffusion1);
         float64x2_t exponent2 = vaddq_f64(drift, diffusion2);
-        float64x2_t ST1 = vmulq_f64(S0_vec,
-		       	float64x2_t{exp(vgetq_lane_f64(exponent1, 0)), exp(vgetq_lane_f64(exponent1, 1))});
-        float64x2_t ST2 = vmulq_f64(S0_vec,
-		       	float64x2_t{exp(vgetq_lane_f64(exponent2, 0)), exp(vgetq_lane_f64(exponent2, 1))});
+        float64x2_t ST1 = vmulq_f64(S0_vec, simd_math::exp_f64x2(exponent1));
+        float64x2_t ST2 = vmulq_f64(S0_vec, simd_math::exp_f64x2(exponent2));
         
 	float64x2_t payoff = vaddq_f64(vmaxq_f64(vsubq_f64(ST1, K_vec), zero),
 			vmaxq_f64(vsubq_f64(ST2, K_vec), zero));
         sum_payoffs += vgetq_lane_f64(payoff, 0) + vgetq_lane_f64(payoff, 1);
     }
+    // Remaining paths when num_simulations is not a multiple of the unrolled step
+    for (; i < num_simulations; ++i) {
+        double ST = S0 * exp((r - q - 0.5 * sigma * sigma) * T + sigma * sqrt(T) * gaussian_box_muller());
+        sum_payoffs += std::max(ST - K, 0.0);
+    }
     return exp(-r * T) * (sum_payoffs / num_simulations);
 }
 
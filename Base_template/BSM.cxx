@@ -3,7 +3,7 @@
     Monte Carlo Hackathon created by Hafsa Demnati and Patrick Demichel @ Viridien 2024
     The code compute a Call Option with a Monte Carlo method and compare the result with the analytical equation of Black-Scholes Merton : more details in the documentation
     
-    Compilation : g++ -O BSM.cxx -o BSM
+    Compilation : g++ -O3 -march=native -fno-math-errno -fopenmp BSM.cxx -o BSM
 
     Exemple of run: ./BSM #simulations #runs
 
@@ -27,6 +27,30 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
    We give points for best performance for each group of runs 
    You need to tune and parallelize the code to run for large # of simulations
 
+
+   This version replaces the copy-pasted SIMD / unroll directories by one
+   kernel template
+
+       black_scholes_monte_carlo<Real, Width, Unroll, Payoff>
+
+   Real = double or float, Width = lanes per vector (2 = NEON f64, 4 = NEON
+   f32 or AVX2 f64, 8 = AVX2 f32), Unroll = independent accumulators,
+   Payoff = CallPayoff or PutPayoff. The lane loops have compile time trip
+   counts, so each instantiation is fully specialized and vectorized by the
+   compiler. The last partial step is masked: lanes past the end are
+   computed on padding and discarded, whatever num_simulations is.
+
+   The normals come from the Philox / Box-Muller generator of
+   ../Base_simd_mpi_openmp, with the same seed and counters for every
+   kernel. The double kernels price the same paths and give the same value;
+   the float kernels draw float normals (float uniforms), so their paths and
+   value differ from the double ones, within the Monte Carlo error.
+
+       ./BSM 1000000 100                 all the kernels side by side
+       ./BSM 1000000 100 --kernel f64x2u4
+
+   compares speed at equal inputs within one precision.
+
 */
 
 #include <iostream>
@@ -36,9 +60,18 @@ Global initial seed: 4208275479      argv[1]= 100     argv[2]= 1000000
 #include <limits>
 #include <algorithm>
 #include <iomanip>   // For setting precision
+#include <string>
+#include <omp.h>
 
 #define ui64 u_int64_t
 
+#include "../Base_simd_mpi_openmp/gaussian.h"
+#include "../Base_simd_mpi_openmp/pricing.h"
+#include "../Base_simd_mpi_openmp/simd_math.h"
+
+// Draws generated and priced at once
+#define TILE 512
+
 #include <sys/time.h>
 double
 dml_micros()
@@ -49,31 +82,87 @@ dml_micros()
         return((tv.tv_sec*1000000.0)+tv.tv_usec);
 }
 
-// Function to generate Gaussian noise using Box-Muller transform
-double gaussian_box_muller() {
-    static std::mt19937 generator(std::random_device{}());
-    static std::normal_distribution<double> distribution(0.0, 1.0);
-    return distribution(generator);
-}
-
-// Function to calculate the Black-Scholes call option price using Monte Carlo method
-double black_scholes_monte_carlo(ui64 S0, ui64 K, double T, double r, double sigma, double q, ui64 num_simulations) {
+template <typename Real>
+struct CallPayoff {
+    Real K;
+    Real operator()(Real ST) const { return std::max(ST - K, Real(0)); }
+};
+
+template <typename Real>
+struct PutPayoff {
+    Real K;
+    Real operator()(Real ST) const { return std::max(K - ST, Real(0)); }
+};
+
+// Function to calculate the Black-Scholes option price using Monte Carlo method
+template <typename Real, int Width, int Unroll, template <typename> class Payoff>
+double black_scholes_monte_carlo(const PricingPlan& plan, ui64 num_simulations, GaussianStream<>& gauss) {
+    constexpr int STEP = Width * Unroll;
+    // Room for the padding read by the masked last step
+    alignas(64) Real Z[TILE + STEP] = {};
+    const Real S0 = (Real)plan.S0, drift = (Real)plan.drift, diffusion = (Real)plan.diffusion;
+    const Payoff<Real> payoff{(Real)plan.K};
     double sum_payoffs = 0.0;
-    for (ui64 i = 0; i < num_simulations; ++i) {
-        double Z = gaussian_box_muller();
-        double ST = S0 * exp((r - q - 0.5 * sigma * sigma) * T + sigma * sqrt(T) * Z);
-        double payoff = std::max(ST - K, 0.0);
-        sum_payoffs += payoff;
+    for (ui64 base = 0; base < num_simulations; base += TILE) {
+        ui64 n = std::min((ui64)TILE, num_simulations - base);
+        gauss.fill_gaussians(Z, n);
+        // Unroll independent vectors of Width lanes, summed in Real over one tile
+        alignas(64) Real acc[Unroll][Width] = {};
+        ui64 i = 0;
+        for (; i + STEP <= n; i += STEP) {
+            for (int u = 0; u < Unroll; ++u) {
+                #pragma omp simd
+                for (int l = 0; l < Width; ++l) {
+                    Real ST = S0 * simd_math::exp(drift + diffusion * Z[i + u * Width + l]);
+                    acc[u][l] += payoff(ST);
+                }
+            }
+        }
+        // Masked tail: one more step, the lanes past n add 0
+        if (i < n) {
+            for (int u = 0; u < Unroll; ++u) {
+                #pragma omp simd
+                for (int l = 0; l < Width; ++l) {
+                    ui64 k = i + u * Width + l;
+                    Real ST = S0 * simd_math::exp(drift + diffusion * Z[k]);
+                    acc[u][l] += k < n ? payoff(ST) : Real(0);
+                }
+            }
+        }
+        // Partial sums flushed to double every tile
+        for (int u = 0; u < Unroll; ++u)
+            for (int l = 0; l < Width; ++l)
+                sum_payoffs += acc[u][l];
     }
-    return exp(-r * T) * (sum_payoffs / num_simulations);
+    return plan.discount * (sum_payoffs / num_simulations);
 }
 
+// The instantiations that replace the Base_simd_* directories
+struct Kernel {
+    const char* name;
+    const char* replaces;
+    double (*price)(const PricingPlan&, ui64, GaussianStream<>&);
+};
+static const Kernel KERNELS[] = {
+    {"f64x1u1",     "Base_version",                black_scholes_monte_carlo<double, 1, 1, CallPayoff>},
+    {"f64x2u1",     "Base_simd_mpi",               black_scholes_monte_carlo<double, 2, 1, CallPayoff>},
+    {"f64x2u2",     "Base_simd_mpi_unroll_2",      black_scholes_monte_carlo<double, 2, 2, CallPayoff>},
+    {"f64x2u4",     "Base_simd_mpi_unroll_4",      black_scholes_monte_carlo<double, 2, 4, CallPayoff>},
+    {"f32x4u1",     "Base_simd_float_mpi_openmp",  black_scholes_monte_carlo<float, 4, 1, CallPayoff>},
+    {"f64x4u1",     "AVX2 double",                 black_scholes_monte_carlo<double, 4, 1, CallPayoff>},
+    {"f64x4u2",     "AVX2 double, unroll 2",       black_scholes_monte_carlo<double, 4, 2, CallPayoff>},
+    {"f32x8u1",     "AVX2 float",                  black_scholes_monte_carlo<float, 8, 1, CallPayoff>},
+    {"f32x8u2",     "AVX2 float, unroll 2",        black_scholes_monte_carlo<float, 8, 2, CallPayoff>},
+    {"put_f64x4u2", "put payoff",                  black_scholes_monte_carlo<double, 4, 2, PutPayoff>},
+};
+
 #include <cmath> // Pour std::erf et std::sqrt
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <num_simulations> <num_runs>" << std::endl;
+    if (argc != 3 && !(argc == 5 && std::string(argv[3]) == "--kernel")) {
+        std::cerr << "Usage: " << argv[0] << " <num_simulations> <num_runs> [--kernel <name>|all]" << std::endl;
         return 1;
     }
+    std::string selected = argc == 5 ? argv[4] : "all";
 
     ui64 num_simulations = std::stoull(argv[1]);
     ui64 num_runs        = std::stoull(argv[2]);
@@ -85,6 +174,7 @@ int main(int argc, char* argv[]) {
     double r     = 0.06;                  // Risk-free interest rate
     double sigma = 0.2;                   // Volatility
     double q     = 0.03;                  // Dividend yield
+    const PricingPlan plan = make_pricing_plan(S0, K, T, r, sigma, q);
 
     // Generate a random seed at the start of the program using random_device
     std::random_device rd;
@@ -92,12 +182,31 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Global initial seed: " << global_seed << "      argv[1]= " << argv[1] << "     argv[2]= " << argv[2] <<  std::endl;
 
-    double sum=0.0;
-    double t1=dml_micros();
-    for (ui64 run = 0; run < num_runs; ++run) {
-        sum+= black_scholes_monte_carlo(S0, K, T, r, sigma, q, num_simulations);
+    bool found = false;
+    for (const Kernel& kernel : KERNELS) {
+        if (selected != "all" && selected != kernel.name) continue;
+        found = true;
+        std::vector<double> run_prices(num_runs);
+        double t1=dml_micros();
+        #pragma omp parallel
+        {
+            GaussianStream<> gauss(global_seed, 0, omp_get_thread_num());
+            #pragma omp for schedule(static)
+            for (ui64 run = 0; run < num_runs; ++run) {
+                gauss.start_run(run);
+                run_prices[run] = kernel.price(plan, num_simulations, gauss);
+            }
+        }
+        double sum=0.0;
+        for (ui64 run = 0; run < num_runs; ++run)
+            sum += run_prices[run];
+        double t2=dml_micros();
+        std::cout << std::setw(12) << kernel.name << std::fixed << std::setprecision(6) << " value= " << sum/num_runs
+                  << " in " << (t2-t1)/1000000.0 << " seconds   (" << kernel.replaces << ")" << std::endl;
+    }
+    if (!found) {
+        std::cerr << "Unknown kernel: " << selected << std::endl;
+        return 1;
     }
-    double t2=dml_micros();
-    std::cout << std::fixed << std::setprecision(6) << " value= " << sum/num_runs << " in " << (t2-t1)/1000000.0 << " seconds" << std::endl;
     return 0;
 }
@@ -1,13 +1,13 @@
-echo "Put the desc of what opt you do"
+echo "One templated kernel <Real, Width, Unroll, Payoff>, every instantiation side by side"
 echo "gcc compiler"
-g++ -O BSM.cxx -o BSM
+g++ -O3 -march=native -fno-math-errno -fopenmp BSM.cxx -o BSM
 for i in {1..10};
 do
 	echo "Run $i"
 	./BSM 100 100000;
 done
 echo "Arm compiler"
-armclang++ -O BSM.cxx -o BSMarm
+armclang++ -O3 -mcpu=native -fno-math-errno -fopenmp BSM.cxx -o BSMarm
 for i in {1..10};
 do
 	echo "Run $i"